@@ -0,0 +1,289 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	allocator.c - Implementation for the arena and pool allocators
+//
+#include "allocator.h"
+#include <string.h>
+#include <stdint.h>
+
+//Every allocation is aligned to this many bytes
+#define ALLOC_ALIGN     (_Alignof(max_align_t))
+#define AlignUp(x)      (((x) + (ALLOC_ALIGN - 1)) & ~(ALLOC_ALIGN - 1))
+
+
+//--------------------- Arena Allocator --------------------------------
+
+//Blocks are linked together, newest first
+typedef struct Arena_Block_t {
+	struct Arena_Block_t* next;
+	size_t size;				// Usable bytes in this block
+	size_t used;				// Bytes handed out from this block
+	max_align_t data[];
+} Arena_Block_t, *pArena_Block_t;
+
+typedef struct {
+	Allocator_t base;			// Must come first (pAllocator_t points here)
+	size_t block_size;			// Default size of each new block
+	size_t total_used;			// Bytes handed out since the last reset
+	void* last;					// Most recent allocation (can be grown or freed in place)
+	pArena_Block_t blocks;		// Current block (the rest follow in the list)
+} Arena_Obj_t, *pArena_Obj_t;
+
+
+static pArena_Block_t arena_new_block(size_t size) {
+	if (size > SIZE_MAX - sizeof(Arena_Block_t)) {return NULL;}
+
+	pArena_Block_t block = malloc(sizeof(Arena_Block_t) + size);
+	if (!block) {return NULL;}
+
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+
+static void* arena_alloc(void* ctx, size_t size) {
+	pArena_Obj_t arena = (pArena_Obj_t) ctx;
+	if (size == 0) {size = 1;}
+	if (size > SIZE_MAX - ALLOC_ALIGN) {return NULL;}
+	size = AlignUp(size);
+
+	pArena_Block_t block = arena->blocks;
+	if (!block || (block->size - block->used < size)) {
+		//Oversized requests get a block all to themselves
+		pArena_Block_t new_block = arena_new_block((size > arena->block_size) ? size : arena->block_size);
+		if (!new_block) {return NULL;}
+
+		new_block->next = block;
+		arena->blocks = block = new_block;
+	}
+
+	void* ptr = ((char*) block->data) + block->used;
+	block->used+=size;
+	arena->total_used+=size;
+	arena->last = ptr;
+	return ptr;
+}
+
+
+static void* arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+	pArena_Obj_t arena = (pArena_Obj_t) ctx;
+	if (!ptr) {return arena_alloc(ctx, new_size);}
+
+	//The most recent allocation can just be resized in place
+	pArena_Block_t block = arena->blocks;
+	if ((ptr == arena->last) && block && (new_size <= SIZE_MAX - ALLOC_ALIGN)) {
+		size_t start = (size_t) ((char*) ptr - (char*) block->data);
+		size_t new_end = start + AlignUp(new_size ? new_size : 1);
+		if (new_end <= block->size) {
+			arena->total_used = arena->total_used - block->used + new_end;
+			block->used = new_end;
+			return ptr;
+		}
+	}
+
+	if (new_size <= old_size) {return ptr;}
+
+	void* new_ptr = arena_alloc(ctx, new_size);
+	if (!new_ptr) {return NULL;}
+	memcpy(new_ptr, ptr, old_size);
+	return new_ptr;
+}
+
+
+//Nothing is released until the arena is reset, except for the most recent allocation
+static void arena_free(void* ctx, void* ptr, size_t size) {
+	pArena_Obj_t arena = (pArena_Obj_t) ctx;
+	pArena_Block_t block = arena->blocks;
+	(void) size;
+
+	if ((ptr == arena->last) && block) {
+		size_t start = (size_t) ((char*) ptr - (char*) block->data);
+		arena->total_used-=(block->used - start);
+		block->used = start;
+		arena->last = NULL;
+	}
+}
+
+
+pAllocator_t new_arena_allocator(size_t block_size) {
+	pArena_Obj_t arena = calloc(1, sizeof(Arena_Obj_t));
+	if (!arena) {return NULL;}
+
+	arena->base.alloc = arena_alloc;
+	arena->base.realloc = arena_realloc;
+	arena->base.free = arena_free;
+	arena->base.ctx = arena;
+	arena->block_size = AlignUp((block_size > 0) ? block_size : 4096);
+
+	return (pAllocator_t) arena;
+}
+
+
+void free_arena_allocator(pAllocator_t a) {
+	pArena_Obj_t arena = (pArena_Obj_t) a;
+	if (!arena) {return;}
+
+	pArena_Block_t block = arena->blocks;
+	while (block) {
+		pArena_Block_t next = block->next;
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
+
+
+void arena_reset(pAllocator_t a) {
+	pArena_Obj_t arena = (pArena_Obj_t) a;
+	if (!arena) {return;}
+
+	//Keep the oldest block, which is a normal-sized one unless it was oversized
+	pArena_Block_t block = arena->blocks;
+	pArena_Block_t keep = NULL;
+	while (block) {
+		pArena_Block_t next = block->next;
+		if (!next && (block->size == arena->block_size)) {keep = block;}
+		else {free(block);}
+		block = next;
+	}
+
+	if (keep) {keep->used = 0;}
+	arena->blocks = keep;
+	arena->total_used = 0;
+	arena->last = NULL;
+}
+
+
+size_t arena_get_used(pAllocator_t a) {
+	pArena_Obj_t arena = (pArena_Obj_t) a;
+	if (!arena) {return 0;}
+	return arena->total_used;
+}
+
+
+
+
+//--------------------- Pool Allocator --------------------------------
+
+typedef struct Pool_Block_t {
+	struct Pool_Block_t* next;
+	max_align_t data[];
+} Pool_Block_t, *pPool_Block_t;
+
+typedef struct Pool_Free_t {
+	struct Pool_Free_t* next;
+} Pool_Free_t, *pPool_Free_t;
+
+typedef struct {
+	Allocator_t base;			// Must come first (pAllocator_t points here)
+	size_t obj_size;			// Size of each object (aligned)
+	size_t objs_per_block;		// Objects carved out of each block
+	pPool_Free_t free_list;		// Objects ready to hand out
+	pPool_Block_t blocks;		// Every block allocated
+} Pool_Obj_t, *pPool_Obj_t;
+
+
+//Add a block, and push all of its objects on the free list
+static bool pool_add_block(pPool_Obj_t pool) {
+	pPool_Block_t block = malloc(sizeof(Pool_Block_t) + pool->obj_size * pool->objs_per_block);
+	if (!block) {return false;}
+
+	block->next = pool->blocks;
+	pool->blocks = block;
+
+	size_t i;
+	char* obj = (char*) block->data;
+	for (i = 0; i < pool->objs_per_block; ++i, obj+=pool->obj_size) {
+		pPool_Free_t item = (pPool_Free_t) obj;
+		item->next = pool->free_list;
+		pool->free_list = item;
+	}
+	return true;
+}
+
+
+static void* pool_alloc(void* ctx, size_t size) {
+	pPool_Obj_t pool = (pPool_Obj_t) ctx;
+	if (size > pool->obj_size) {return NULL; /* Too big for this pool */}
+
+	if (!pool->free_list && !pool_add_block(pool)) {return NULL;}
+
+	pPool_Free_t item = pool->free_list;
+	pool->free_list = item->next;
+	return item;
+}
+
+static void* pool_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+	pPool_Obj_t pool = (pPool_Obj_t) ctx;
+	(void) old_size;
+	if (!ptr) {return pool_alloc(ctx, new_size);}
+	return (new_size <= pool->obj_size) ? ptr : NULL;
+}
+
+static void pool_free(void* ctx, void* ptr, size_t size) {
+	pPool_Obj_t pool = (pPool_Obj_t) ctx;
+	(void) size;
+
+	pPool_Free_t item = (pPool_Free_t) ptr;
+	item->next = pool->free_list;
+	pool->free_list = item;
+}
+
+
+pAllocator_t new_pool_allocator(size_t obj_size, size_t objs_per_block) {
+	if ((obj_size == 0) || (objs_per_block == 0)) {return NULL;}
+	if (obj_size < sizeof(Pool_Free_t)) {obj_size = sizeof(Pool_Free_t);}
+	if (obj_size > SIZE_MAX - ALLOC_ALIGN) {return NULL;}
+
+	obj_size = AlignUp(obj_size);
+	if (objs_per_block > (SIZE_MAX - sizeof(Pool_Block_t)) / obj_size) {return NULL;}
+
+	pPool_Obj_t pool = calloc(1, sizeof(Pool_Obj_t));
+	if (!pool) {return NULL;}
+
+	pool->base.alloc = pool_alloc;
+	pool->base.realloc = pool_realloc;
+	pool->base.free = pool_free;
+	pool->base.ctx = pool;
+	pool->obj_size = obj_size;
+	pool->objs_per_block = objs_per_block;
+
+	return (pAllocator_t) pool;
+}
+
+
+void free_pool_allocator(pAllocator_t p) {
+	pPool_Obj_t pool = (pPool_Obj_t) p;
+	if (!pool) {return;}
+
+	pPool_Block_t block = pool->blocks;
+	while (block) {
+		pPool_Block_t next = block->next;
+		free(block);
+		block = next;
+	}
+	free(pool);
+}
+
+
+void pool_reset(pAllocator_t p) {
+	pPool_Obj_t pool = (pPool_Obj_t) p;
+	if (!pool) {return;}
+
+	//Rebuild the free list from scratch
+	pPool_Block_t block = pool->blocks;
+	pool->free_list = NULL;
+	while (block) {
+		size_t i;
+		char* obj = (char*) block->data;
+		for (i = 0; i < pool->objs_per_block; ++i, obj+=pool->obj_size) {
+			pPool_Free_t item = (pPool_Free_t) obj;
+			item->next = pool->free_list;
+			pool->free_list = item;
+		}
+		block = block->next;
+	}
+}
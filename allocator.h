@@ -0,0 +1,70 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	allocator.h - Header for pluggable memory allocators
+//
+//	  Every data structure can be given an allocator when it is created. Passing NULL (or using
+//	  the normal constructor) uses malloc, realloc and free.
+//
+//	  Two allocators are included:
+//	    Arena - Bump allocator: free does nothing, and reset releases everything at once
+//	    Pool  - Fixed-size blocks with a free list (allocations bigger than the block fail)
+//
+#ifndef ALLOCATOR_HEADER
+#define ALLOCATOR_HEADER
+
+#include <stddef.h>	/* For size_t */
+#include <stdbool.h>
+#include <stdlib.h>
+
+//Allocator interface
+//  The size of every block is passed back to realloc and free, for allocators that need it
+typedef struct {
+	void* (*alloc)(void* ctx, size_t size);
+	void* (*realloc)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+	void  (*free)(void* ctx, void* ptr, size_t size);
+	void* ctx;			// User context passed to every function
+} Allocator_t, *pAllocator_t;
+
+
+//Wrappers that fall back to the C library when alloc is NULL
+static inline void* mem_alloc(pAllocator_t alloc, size_t size) {
+	if (!alloc) {return malloc(size);}
+	return alloc->alloc(alloc->ctx, size);
+}
+
+static inline void* mem_realloc(pAllocator_t alloc, void* ptr, size_t old_size, size_t new_size) {
+	if (!alloc) {return realloc(ptr, new_size);}
+	return alloc->realloc(alloc->ctx, ptr, old_size, new_size);
+}
+
+static inline void mem_free(pAllocator_t alloc, void* ptr, size_t size) {
+	if (!ptr) {return;}
+	if (!alloc) {free(ptr); return;}
+	alloc->free(alloc->ctx, ptr, size);
+}
+
+
+//************Arena Allocator************
+
+//Memory is carved out of blocks of (at least) block_size bytes
+pAllocator_t new_arena_allocator(size_t block_size);
+void free_arena_allocator(pAllocator_t arena);
+
+//Release everything allocated from the arena (keeps the first block for reuse)
+void arena_reset(pAllocator_t arena);
+
+//Total number of bytes handed out since the last reset
+size_t arena_get_used(pAllocator_t arena);
+
+
+//************Pool Allocator************
+
+//Every allocation is one object of obj_size bytes, carved from blocks of objs_per_block objects
+pAllocator_t new_pool_allocator(size_t obj_size, size_t objs_per_block);
+void free_pool_allocator(pAllocator_t pool);
+
+//Return every object to the pool at once (keeps the blocks for reuse)
+void pool_reset(pAllocator_t pool);
+
+#endif // ALLOCATOR_HEADER Included
@@ -0,0 +1,98 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_array_bench.c - Append throughput of the Concurrent Dynamic Array
+//
+//	  For 1 to 32 threads, every thread appends its share of the elements. The same work is
+//	  then done on a Dynamic Array behind a mutex, for comparison.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 -pthread -I. bench/concurrent_array_bench.c concurrent_array.c dynamic_array.c allocator.c -o concurrent_array_bench
+//	  Usage: ./concurrent_array_bench [total elements] [max threads]
+//
+#include "concurrent_array.h"
+#include "dynamic_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct {
+    pConcurrent_Arr_t conc;
+    pDynamic_Arr_t locked;
+    pthread_mutex_t* lock;
+    size_t count;
+} Append_Job_t;
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* concurrent_append(void* arg) {
+    Append_Job_t* job = (Append_Job_t*) arg;
+    uint64_t i;
+    for (i = 0; i < job->count; ++i) {add_concurrent_array_element(job->conc, &i, NULL);}
+    return NULL;
+}
+
+static void* locked_append(void* arg) {
+    Append_Job_t* job = (Append_Job_t*) arg;
+    uint64_t i;
+    for (i = 0; i < job->count; ++i) {
+        pthread_mutex_lock(job->lock);
+        add_array_element(job->locked, &i);
+        pthread_mutex_unlock(job->lock);
+    }
+    return NULL;
+}
+
+
+//Returns millions of appends per second
+static double run(size_t threads, size_t total, bool concurrent) {
+    pthread_t tid[32];
+    Append_Job_t jobs[32];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pConcurrent_Arr_t conc = concurrent ? new_concurrent_array(sizeof(uint64_t)) : NULL;
+    pDynamic_Arr_t locked = concurrent ? NULL : new_dynamic_array(sizeof(uint64_t));
+
+    size_t i;
+    double start = now();
+    for (i = 0; i < threads; ++i) {
+        jobs[i].conc = conc;
+        jobs[i].locked = locked;
+        jobs[i].lock = &lock;
+        jobs[i].count = (total / threads) + ((i < (total % threads)) ? 1 : 0);
+        pthread_create(&tid[i], NULL, concurrent ? concurrent_append : locked_append, &jobs[i]);
+    }
+    for (i = 0; i < threads; ++i) {pthread_join(tid[i], NULL);}
+    double elapsed = now() - start;
+
+    size_t count = concurrent ? get_concurrent_array_count(conc) : get_array_count(locked);
+    if (count != total) {fprintf(stderr, "Expected %zu elements, got %zu\n", total, count); exit(1);}
+
+    if (conc) {free_concurrent_array(conc, NULL);}
+    if (locked) {free_dynamic_array(locked, NULL);}
+    return (total / elapsed) / 1e6;
+}
+
+
+int main(int argc, char** argv) {
+    size_t total = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000000;
+    size_t max_threads = (argc > 2) ? strtoul(argv[2], NULL, 10) : 32;
+    if (max_threads > 32) {max_threads = 32;}
+
+    printf("%zu appends of 8 bytes\n", total);
+    printf("threads   concurrent (M/s)   mutex + dynamic array (M/s)\n");
+
+    size_t threads;
+    for (threads = 1; threads <= max_threads; threads*=2) {
+        double conc = run(threads, total, true);
+        double locked = run(threads, total, false);
+        printf("%7zu   %16.1f   %27.1f\n", threads, conc, locked);
+    }
+    return 0;
+}
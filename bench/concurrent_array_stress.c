@@ -0,0 +1,129 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_array_stress.c - Stress test for the Concurrent Dynamic Array
+//
+//	  Several writers append at once while a reader keeps checking the published count.
+//	  Afterwards every element must have been published exactly once.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 -pthread -I. bench/concurrent_array_stress.c concurrent_array.c -o concurrent_array_stress
+//	  Usage: ./concurrent_array_stress [writers] [elements per writer] [rounds]
+//
+#include "concurrent_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+typedef struct {
+    pConcurrent_Arr_t arr;
+    uint64_t writer;
+    size_t count;
+    bool ok;
+} Writer_t;
+
+typedef struct {
+    pConcurrent_Arr_t arr;
+    atomic_bool stop;
+    bool ok;
+} Reader_t;
+
+
+//Every element holds (writer << 32) | sequence number
+static void* writer_thread(void* arg) {
+    Writer_t* w = (Writer_t*) arg;
+    size_t i, index;
+    w->ok = true;
+    for (i = 0; i < w->count; ++i) {
+        uint64_t value = (w->writer << 32) | i;
+        if (!add_concurrent_array_element(w->arr, &value, &index)) {w->ok = false; return NULL;}
+        if (*(uint64_t*) get_concurrent_array_element(w->arr, index) != value) {w->ok = false;}
+    }
+    return NULL;
+}
+
+//The published count must never go backwards, and everything below it must be readable
+static void* reader_thread(void* arg) {
+    Reader_t* r = (Reader_t*) arg;
+    size_t last = 0;
+    r->ok = true;
+    while (!atomic_load(&r->stop)) {
+        size_t count = get_concurrent_array_count(r->arr);
+        if (count < last) {r->ok = false;}
+        if ((count > 0) && !get_concurrent_array_element(r->arr, count - 1)) {r->ok = false;}
+        if (get_concurrent_array_claimed(r->arr) < count) {r->ok = false;}
+        last = count;
+    }
+    return NULL;
+}
+
+
+static bool run_round(size_t writers, size_t per_writer) {
+    pConcurrent_Arr_t arr = new_concurrent_array(sizeof(uint64_t));
+    Writer_t* w = calloc(writers, sizeof(Writer_t));
+    pthread_t* threads = calloc(writers, sizeof(pthread_t));
+    uint8_t* seen = calloc(writers * per_writer, 1);
+    if (!(arr && w && threads && seen)) {fprintf(stderr, "Out of memory\n"); exit(1);}
+
+    Reader_t r;
+    r.arr = arr;
+    atomic_init(&r.stop, false);
+    pthread_t reader;
+    pthread_create(&reader, NULL, reader_thread, &r);
+
+    size_t i;
+    for (i = 0; i < writers; ++i) {
+        w[i].arr = arr;
+        w[i].writer = i;
+        w[i].count = per_writer;
+        pthread_create(&threads[i], NULL, writer_thread, &w[i]);
+    }
+    for (i = 0; i < writers; ++i) {pthread_join(threads[i], NULL);}
+    atomic_store(&r.stop, true);
+    pthread_join(reader, NULL);
+
+    bool ok = r.ok;
+    for (i = 0; i < writers; ++i) {ok = ok && w[i].ok;}
+
+    //Every value shows up exactly once
+    size_t total = writers * per_writer;
+    if ((get_concurrent_array_count(arr) != total) || (get_concurrent_array_claimed(arr) != total)) {ok = false;}
+    for (i = 0; ok && (i < total); ++i) {
+        uint64_t* p = (uint64_t*) get_concurrent_array_element(arr, i);
+        if (!p) {ok = false; break;}
+
+        uint64_t writer = *p >> 32, seq = *p & 0xFFFFFFFF;
+        if ((writer >= writers) || (seq >= per_writer)) {ok = false; break;}
+        if (seen[writer * per_writer + seq]++) {ok = false;}
+    }
+    if (get_concurrent_array_element(arr, total)) {ok = false;}
+
+    free(seen);
+    free(threads);
+    free(w);
+    free_concurrent_array(arr, NULL);
+    return ok;
+}
+
+
+int main(int argc, char** argv) {
+    size_t writers = (argc > 1) ? strtoul(argv[1], NULL, 10) : 8;
+    size_t per_writer = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1000000;
+    size_t rounds = (argc > 3) ? strtoul(argv[3], NULL, 10) : 10;
+    if ((writers == 0) || (per_writer == 0) || (per_writer > 0xFFFFFFFF)) {
+        fprintf(stderr, "Usage: %s [writers] [elements per writer] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    size_t i;
+    for (i = 0; i < rounds; ++i) {
+        if (!run_round(writers, per_writer)) {
+            printf("FAILED on round %zu (%zu writers, %zu elements each)\n", i + 1, writers, per_writer);
+            return 1;
+        }
+    }
+    printf("OK: %zu rounds of %zu writers x %zu elements\n", rounds, writers, per_writer);
+    return 0;
+}
@@ -0,0 +1,149 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_dyll_bench.c - Reader scaling of the Concurrent DyLL
+//
+//	  One writer keeps adding and deleting items at random positions while 1, 2, 4, ...
+//	  readers scan the whole list over and over. Prints the scans per second for each
+//	  reader count, along with how many changes the writer made in the meantime.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 -pthread -I. bench/concurrent_dyll_bench.c concurrent_dyll.c -o concurrent_dyll_bench
+//	  Usage: ./concurrent_dyll_bench [items] [max readers] [seconds per run]
+//
+#include "concurrent_dyll.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct {
+    pCDyLL_Arr_t list;
+    size_t items;
+    atomic_bool stop;
+} Bench_t;
+
+typedef struct {
+    Bench_t* bench;
+    pthread_t tid;
+    size_t count;           // Scans (readers) or changes (writer) finished
+    uint64_t checksum;      // Sum of everything a reader saw (so the loads aren't optimized away)
+    bool ok;
+} Worker_t;
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t next_random(uint64_t* seed) {
+    *seed ^= *seed << 13; *seed ^= *seed >> 7; *seed ^= *seed << 17;
+    return *seed;
+}
+
+
+//Every version the readers can pin holds either items or items + 1
+static void* writer_thread(void* arg) {
+    Worker_t* w = (Worker_t*) arg;
+    Bench_t* b = w->bench;
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    w->ok = true;
+
+    while (!atomic_load_explicit(&b->stop, memory_order_relaxed)) {
+        uint64_t value = next_random(&seed);
+        if (!cdyll_add_element_before(b->list, value % b->items, &value, sizeof(value))) {w->ok = false; break;}
+        if (!cdyll_delete_element(b->list, next_random(&seed) % (b->items + 1))) {w->ok = false; break;}
+        w->count+=2;
+    }
+    return NULL;
+}
+
+static void* reader_thread(void* arg) {
+    Worker_t* w = (Worker_t*) arg;
+    Bench_t* b = w->bench;
+    w->ok = true;
+
+    while (!atomic_load_explicit(&b->stop, memory_order_relaxed)) {
+        CDyLL_Reader_t reader;
+        if (!cdyll_read_begin(b->list, &reader)) {w->ok = false; break;}
+
+        size_t seen = 0, len;
+        uint64_t sum = 0;
+        const void* p;
+        while ((p = cdyll_read_next(&reader, &len))) {
+            sum+=*(const uint64_t*) p;
+            ++seen;
+        }
+        cdyll_read_end(&reader);
+
+        if ((seen != b->items) && (seen != b->items + 1)) {w->ok = false; break;}
+        w->checksum+=sum;
+        w->count+=1;
+    }
+    return NULL;
+}
+
+
+int main(int argc, char** argv) {
+    size_t items = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t max_readers = (argc > 2) ? strtoul(argv[2], NULL, 10) : 16;
+    double seconds = (argc > 3) ? atof(argv[3]) : 1.0;
+    if ((items == 0) || (max_readers == 0)) {
+        fprintf(stderr, "Usage: %s [items] [max readers] [seconds per run]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu items, one writer\n", items);
+    printf("readers   scans/s (total)   scans/s (per reader)   writer changes/s\n");
+
+    size_t readers;
+    for (readers = 1; readers <= max_readers; readers*=2) {
+        Bench_t b;
+        b.list = new_concurrent_dyll(readers);
+        b.items = items;
+        atomic_init(&b.stop, false);
+        if (!b.list) {fprintf(stderr, "Out of memory\n"); return 1;}
+
+        size_t i;
+        uint64_t value;
+        for (i = 0; i < items; ++i) {value = i; cdyll_add_element(b.list, &value, sizeof(value));}
+
+        Worker_t writer = {0};
+        writer.bench = &b;
+        Worker_t* r = calloc(readers, sizeof(Worker_t));
+        if (!r) {fprintf(stderr, "Out of memory\n"); return 1;}
+
+        double start = now();
+        pthread_create(&writer.tid, NULL, writer_thread, &writer);
+        for (i = 0; i < readers; ++i) {
+            r[i].bench = &b;
+            pthread_create(&r[i].tid, NULL, reader_thread, &r[i]);
+        }
+
+        struct timespec pause = {(time_t) seconds, (long) ((seconds - (time_t) seconds) * 1e9)};
+        nanosleep(&pause, NULL);
+        atomic_store(&b.stop, true);
+
+        size_t scans = 0;
+        bool ok = true;
+        pthread_join(writer.tid, NULL);
+        for (i = 0; i < readers; ++i) {
+            pthread_join(r[i].tid, NULL);
+            scans+=r[i].count;
+            ok = ok && r[i].ok;
+        }
+        double elapsed = now() - start;
+        if (!(ok && writer.ok)) {fprintf(stderr, "A reader saw the wrong number of items\n"); return 1;}
+
+        printf("%7zu   %15.0f   %20.0f   %16.0f\n", readers,
+               scans / elapsed, scans / elapsed / readers, writer.count / elapsed);
+
+        free(r);
+        free_concurrent_dyll(b.list);
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	parallel_array_bench.c - Scaling of the parallel Dynamic Array operations
+//
+//	  Times parallel_for_each, parallel_map, parallel_reduce and parallel_sort on the same
+//	  array with 1, 2, 4, ... threads, using the automatic grain size. sort_dynamic_array is
+//	  timed once as the single-threaded baseline.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 -pthread -I. bench/parallel_array_bench.c dynamic_array_parallel.c dynamic_array.c thread_pool.c allocator.c -lm -o parallel_array_bench
+//	  Usage: ./parallel_array_bench [elements] [max threads]
+//
+#include "dynamic_array_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//Some real work per element, so the loops are not just memory bound
+static void each_func(void* element, void* ctx) {
+    (void) ctx;
+    double* d = (double*) element;
+    *d = sqrt(*d * *d + 1.0);
+}
+
+static void map_func(void* out, const void* element, void* ctx) {
+    (void) ctx;
+    *(double*) out = sin(*(const double*) element);
+}
+
+static void sum_func(void* acc, const void* element, void* ctx) {
+    (void) ctx;
+    *(double*) acc += *(const double*) element;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+
+static pDynamic_Arr_t random_array(size_t n) {
+    pDynamic_Arr_t arr = new_dynamic_array(sizeof(double));
+    if (!(arr && reserve_array(arr, n))) {fprintf(stderr, "Out of memory\n"); exit(1);}
+
+    size_t i;
+    uint64_t seed = 88172645463325252ull;
+    for (i = 0; i < n; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        double d = (double) (seed >> 11) / (double) (1ull << 53);
+        add_array_element(arr, &d);
+    }
+    return arr;
+}
+
+static bool is_sorted(pDynamic_Arr_t arr) {
+    size_t i, n = get_array_count(arr);
+    for (i = 1; i < n; ++i) {
+        if (compare_doubles(get_array_element(arr, i-1), get_array_element(arr, i)) > 0) {return false;}
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+    size_t max_threads = (argc > 2) ? strtoul(argv[2], NULL, 10) : 32;
+
+    pDynamic_Arr_t arr = random_array(n);
+    double start = now();
+    sort_dynamic_array(arr, compare_doubles);
+    printf("%zu doubles, sort_dynamic_array: %.3f s\n\n", n, now() - start);
+    free_dynamic_array(arr, NULL);
+
+    printf("threads   for_each (s)   map (s)   reduce (s)   sort (s)   sort speedup\n");
+    double sort_one = 0;
+    size_t threads;
+    for (threads = 1; threads <= max_threads; threads*=2) {
+        pThread_Pool_t pool = new_thread_pool(threads);
+        arr = random_array(n);
+
+        start = now();
+        parallel_for_each(arr, each_func, NULL, pool, 0);
+        double t_each = now() - start;
+
+        start = now();
+        pDynamic_Arr_t out = parallel_map(arr, sizeof(double), map_func, NULL, pool, 0);
+        double t_map = now() - start;
+        free_dynamic_array(out, NULL);
+
+        double sum, zero = 0;
+        start = now();
+        parallel_reduce(arr, &sum, &zero, sum_func, NULL, pool, 0);
+        double t_reduce = now() - start;
+
+        start = now();
+        parallel_sort(arr, compare_doubles, pool, 0);
+        double t_sort = now() - start;
+        if (!is_sorted(arr)) {fprintf(stderr, "parallel_sort failed with %zu threads\n", threads); return 1;}
+        if (threads == 1) {sort_one = t_sort;}
+
+        printf("%7zu   %12.3f   %7.3f   %10.3f   %8.3f   %12.2f\n",
+               threads, t_each, t_map, t_reduce, t_sort, sort_one / t_sort);
+
+        free_dynamic_array(arr, NULL);
+        free_thread_pool(pool);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	xml_gen.c - Writes a large XML document for benchmarking the parser
+//
+//	  The document is a catalog of records with attributes, entities, CDATA, comments,
+//	  self-closing tags and a few levels of nesting. The output is the same for the same size.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 bench/xml_gen.c -o xml_gen
+//	  Usage: ./xml_gen [megabytes] [output file] (writes to stdout without a file)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static const char* words[] = {
+	"parser", "buffer", "element", "attribute", "stream", "arena", "node", "tree",
+	"thread", "chunk", "entity", "record", "catalog", "value", "index", "cursor"
+};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+
+static uint64_t next_random(uint64_t* seed) {
+	*seed ^= *seed << 13; *seed ^= *seed >> 7; *seed ^= *seed << 17;
+	return *seed;
+}
+
+//A sentence of count random words
+static size_t write_words(FILE* out, uint64_t* seed, size_t count) {
+	size_t i, len = 0;
+	for (i = 0; i < count; ++i) {
+		len+=fprintf(out, "%s%s", (i ? " " : ""), words[next_random(seed) % NUM_WORDS]);
+	}
+	return len;
+}
+
+//One record, returning the number of bytes written
+static size_t write_record(FILE* out, uint64_t* seed, size_t id) {
+	size_t len = 0, i;
+	uint64_t r = next_random(seed);
+
+	len+=fprintf(out, "  <record id=\"r%zu\" type=\"%s\" score=\"%u.%02u\">\n",
+	             id, words[r % NUM_WORDS], (unsigned) (r >> 8) % 1000, (unsigned) (r >> 20) % 100);
+	len+=fprintf(out, "    <title>");
+	len+=write_words(out, seed, 3 + (r >> 32) % 5);
+	len+=fprintf(out, "</title>\n");
+
+	//Entities in text and attributes
+	len+=fprintf(out, "    <author name=\"Smith &amp; Jones\" contact=\"&lt;list&gt;\">A &quot;quoted&quot; &amp; escaped author</author>\n");
+
+	//Nested elements, some of them self-closing
+	len+=fprintf(out, "    <tags>\n");
+	for (i = 0; i < 1 + (r >> 40) % 4; ++i) {
+		len+=fprintf(out, "      <tag key=\"%s\" weight='%zu'/>\n", words[next_random(seed) % NUM_WORDS], i);
+	}
+	len+=fprintf(out, "    </tags>\n");
+
+	if ((r >> 48) % 4 == 0) {len+=fprintf(out, "    <!-- record %zu was generated -->\n", id);}
+	if ((r >> 52) % 3 == 0) {
+		len+=fprintf(out, "    <code><![CDATA[if (a < b && c > d) { return \"x\"; }]]></code>\n");
+	}
+
+	len+=fprintf(out, "    <body>\n      <p>");
+	len+=write_words(out, seed, 20 + (r >> 56) % 40);
+	len+=fprintf(out, "</p>\n      <p>");
+	len+=write_words(out, seed, 10 + (r >> 4) % 20);
+	len+=fprintf(out, "</p>\n    </body>\n  </record>\n");
+	return len;
+}
+
+
+int main(int argc, char** argv) {
+	size_t mb = (argc > 1) ? strtoul(argv[1], NULL, 10) : 256;
+	FILE* out = (argc > 2) ? fopen(argv[2], "wb") : stdout;
+	if (!out) {perror(argv[2]); return 1;}
+
+	size_t target = mb << 20, written = 0, id = 0;
+	uint64_t seed = 0x2545F4914F6CDD1Dull;
+
+	written+=fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	written+=fprintf(out, "<!DOCTYPE catalog>\n<catalog version=\"1\">\n");
+	while (written < target) {written+=write_record(out, &seed, id++);}
+	written+=fprintf(out, "</catalog>\n");
+
+	if (out != stdout) {fclose(out);}
+	fprintf(stderr, "Wrote %zu records (%.1f MB)\n", id, written / 1048576.0);
+	return 0;
+}
@@ -0,0 +1,136 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	xml_parse_bench.c - Parser throughput in MB/s
+//
+//	  Loads a document into memory (so disk speed doesn't count), then times xml_parse(),
+//	  xml_doc_parse() and the stream parser fed in 64 KB chunks. Each one is run several
+//	  times and the best run is reported. Use xml_gen.c to make a test document.
+//
+//	  Build (from the repository root):
+//	    gcc -O2 -I. bench/xml_parse_bench.c xml.c allocator.c -o xml_parse_bench
+//	  Usage: ./xml_gen 256 catalog.xml && ./xml_parse_bench catalog.xml [runs]
+//
+#define _POSIX_C_SOURCE 200809L	/* For clock_gettime */
+
+#include "xml.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STREAM_CHUNK  65536
+
+typedef struct {
+	size_t elements;
+	size_t text_bytes;
+} Stream_Count_t;
+
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char* load_file(const char* path, size_t* len) {
+	FILE* f = fopen(path, "rb");
+	if (!f) {return NULL;}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char* text = (size >= 0) ? malloc((size_t) size + 1) : NULL;
+	if (text && (fread(text, 1, (size_t) size, f) != (size_t) size)) {free(text); text = NULL;}
+	fclose(f);
+
+	if (text) {*len = (size_t) size;}
+	return text;
+}
+
+
+static bool count_start(void* ctx, const char* name, const XML_ATTRIB_t* attrib, size_t num_attrib) {
+	(void) name; (void) attrib; (void) num_attrib;
+	((Stream_Count_t*) ctx)->elements+=1;
+	return true;
+}
+
+static bool count_text(void* ctx, const char* text, size_t len) {
+	(void) text;
+	((Stream_Count_t*) ctx)->text_bytes+=len;
+	return true;
+}
+
+
+//Each returns the parse time in seconds (or a negative number if parsing failed)
+static double time_dom(const char* text, size_t len) {
+	double start = now();
+	pXML_NODE_t root = xml_parse(text, len);
+	double elapsed = now() - start;
+	if (!root) {return -1;}
+	free_xml_node(root);
+	return elapsed;
+}
+
+static double time_doc(const char* text, size_t len) {
+	pXML_Doc_t doc = new_xml_doc();
+	double start = now();
+	pXML_NODE_t root = xml_doc_parse(doc, text, len);
+	double elapsed = now() - start;
+	free_xml_doc(doc);
+	return root ? elapsed : -1;
+}
+
+static double time_stream(const char* text, size_t len) {
+	Stream_Count_t count = {0, 0};
+	double start = now();
+	pXML_Stream_t stream = new_xml_stream(count_start, count_text, NULL, &count);
+
+	size_t i;
+	bool ok = (stream != NULL);
+	for (i = 0; ok && (i < len); i+=STREAM_CHUNK) {
+		ok = xml_stream_feed(stream, text + i, ((len - i) < STREAM_CHUNK) ? (len - i) : STREAM_CHUNK);
+	}
+	ok = ok && xml_stream_finish(stream);
+	double elapsed = now() - start;
+
+	free_xml_stream(stream);
+	return ok ? elapsed : -1;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <file.xml> [runs]\n", argv[0]);
+		return 1;
+	}
+	size_t runs = (argc > 2) ? strtoul(argv[2], NULL, 10) : 3;
+	if (runs == 0) {runs = 1;}
+
+	size_t len;
+	char* text = load_file(argv[1], &len);
+	if (!text) {perror(argv[1]); return 1;}
+
+	struct {const char* name; double (*func)(const char*, size_t);} tests[] = {
+		{"xml_parse", time_dom},
+		{"xml_doc_parse", time_doc},
+		{"xml_stream_feed", time_stream}
+	};
+
+	double mb = len / 1048576.0;
+	printf("%.1f MB, best of %zu runs\n", mb, runs);
+
+	size_t t, r;
+	for (t = 0; t < sizeof(tests) / sizeof(tests[0]); ++t) {
+		double best = -1;
+		for (r = 0; r < runs; ++r) {
+			double elapsed = tests[t].func(text, len);
+			if (elapsed < 0) {fprintf(stderr, "%s failed to parse %s\n", tests[t].name, argv[1]); return 1;}
+			if ((best < 0) || (elapsed < best)) {best = elapsed;}
+		}
+		printf("%-16s %8.3f s %8.1f MB/s\n", tests[t].name, best, mb / best);
+	}
+
+	free(text);
+	return 0;
+}
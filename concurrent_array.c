@@ -0,0 +1,199 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_array.c - Implementation for the Concurrent Dynamic Array data structure
+//
+#include "concurrent_array.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define FIRST_SEGMENT_BITS  6       //First segment holds 64 elements
+#define MAX_SEGMENTS        (sizeof(size_t) * 8 - FIRST_SEGMENT_BITS)
+
+//Slot states (stored after the elements in each segment)
+#define SLOT_EMPTY      0       // Claimed, but still being written
+#define SLOT_READY      1       // Completely written
+
+
+// Private Concurrent Array object
+typedef struct {
+    size_t el_size;                     // How big is each element
+    atomic_size_t claimed;              // Next slot to hand out to a writer
+    atomic_size_t published;            // Every slot below this is ready; an abandoned slot stops it from advancing
+
+    _Atomic(char*) seg[MAX_SEGMENTS];   // Segment k holds (64 << k) elements, then the slot states
+} Concurrent_Obj_t, *pConcurrent_Obj_t;
+
+
+
+//Which segment holds index, and where inside of it
+//  Segment k starts at index (64 << k) - 64, so adding 64 turns the index into a power-of-2 bucket
+static inline size_t conc_segment(size_t index, size_t* offset) {
+    size_t biased = index + ((size_t) 1 << FIRST_SEGMENT_BITS);
+    size_t top = (sizeof(size_t) * 8 - 1) - (size_t) __builtin_clzll((unsigned long long) biased);
+    size_t seg = top - FIRST_SEGMENT_BITS;
+    *offset = biased - ((size_t) 1 << top);
+    return seg;
+}
+
+static inline size_t conc_segment_len(size_t seg) {
+    return ((size_t) 1 << FIRST_SEGMENT_BITS) << seg;
+}
+
+static inline atomic_uchar* conc_states(pConcurrent_Obj_t arr, char* seg, size_t seg_idx) {
+    return (atomic_uchar*) (seg + conc_segment_len(seg_idx) * arr->el_size);
+}
+
+
+//Get a segment, allocating it if nobody else has yet
+//  Racing writers each allocate one, but only the first one gets installed
+static char* conc_get_segment(pConcurrent_Obj_t arr, size_t seg_idx) {
+    char* seg = atomic_load_explicit(&arr->seg[seg_idx], memory_order_acquire);
+    if (seg) {return seg;}
+
+    size_t len = conc_segment_len(seg_idx);
+    if (len > (SIZE_MAX / (arr->el_size + 1))) {return NULL; /* Overflow */}
+
+    char* new_seg = malloc(len * arr->el_size + len * sizeof(atomic_uchar));
+    if (!new_seg) {return NULL;}
+
+    size_t i;
+    atomic_uchar* states = conc_states(arr, new_seg, seg_idx);
+    for (i = 0; i < len; ++i) {atomic_init(&states[i], SLOT_EMPTY);}
+
+    char* expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&arr->seg[seg_idx], &expected, new_seg,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        free(new_seg);
+        return expected;
+    }
+    return new_seg;
+}
+
+
+static inline unsigned char conc_slot_state(pConcurrent_Obj_t arr, size_t index) {
+    size_t offset;
+    size_t seg_idx = conc_segment(index, &offset);
+    char* seg = atomic_load_explicit(&arr->seg[seg_idx], memory_order_acquire);
+    if (!seg) {return SLOT_EMPTY;}
+    return atomic_load_explicit(&conc_states(arr, seg, seg_idx)[offset], memory_order_acquire);
+}
+
+
+//Move the published count past every finished slot
+static size_t conc_publish(pConcurrent_Obj_t arr) {
+    size_t pub = atomic_load_explicit(&arr->published, memory_order_acquire);
+    while (1) {
+        size_t claimed = atomic_load_explicit(&arr->claimed, memory_order_acquire);
+        size_t end = pub;
+        while ((end < claimed) && (conc_slot_state(arr, end) == SLOT_READY)) {++end;}
+        if (end == pub) {return pub;}
+
+        //On failure, pub is reloaded with whatever another thread published
+        if (atomic_compare_exchange_weak_explicit(&arr->published, &pub, end,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            return end;
+        }
+    }
+}
+
+
+
+
+pConcurrent_Arr_t new_concurrent_array(size_t el_size) {
+    if (el_size == 0) {return NULL;}
+
+    pConcurrent_Obj_t arr = malloc(sizeof(Concurrent_Obj_t));
+    if (!arr) {return NULL;}
+
+    arr->el_size = el_size;
+    atomic_init(&arr->claimed, 0);
+    atomic_init(&arr->published, 0);
+
+    size_t i;
+    for (i = 0; i < MAX_SEGMENTS; ++i) {atomic_init(&arr->seg[i], NULL);}
+
+    return (pConcurrent_Arr_t) arr;
+}
+
+
+void free_concurrent_array(pConcurrent_Arr_t a, Free_Func_t func) {
+
+    pConcurrent_Obj_t arr = (pConcurrent_Obj_t) a;
+    if (!arr) {return;}
+
+    if (func != NULL) {
+        size_t i, count = conc_publish(arr);
+        for (i = 0; i < count; ++i) {
+            void* el = get_concurrent_array_element(arr, i);
+            if (el) {func(*(void**) el);}
+        }
+    }
+
+    size_t i;
+    for (i = 0; i < MAX_SEGMENTS; ++i) {
+        char* seg = atomic_load_explicit(&arr->seg[i], memory_order_relaxed);
+        if (seg) {free(seg);}
+    }
+    free(arr);
+}
+
+
+
+bool add_concurrent_array_element(pConcurrent_Arr_t a, const void* new, size_t* index) {
+
+    pConcurrent_Obj_t arr = (pConcurrent_Obj_t) a;
+    if (!(arr && new)) {return false;}
+
+    //Claim a slot, then make sure its segment exists
+    size_t slot = atomic_fetch_add_explicit(&arr->claimed, 1, memory_order_relaxed);
+    size_t offset;
+    size_t seg_idx = conc_segment(slot, &offset);
+    if (seg_idx >= MAX_SEGMENTS) {return false;}
+
+    //Out of memory: the claimed slot can never be filled, so nothing past it gets published
+    char* seg = conc_get_segment(arr, seg_idx);
+    if (!seg) {return false;}
+
+    memcpy(seg + offset * arr->el_size, new, arr->el_size);
+    atomic_store_explicit(&conc_states(arr, seg, seg_idx)[offset], SLOT_READY, memory_order_release);
+
+    if (index != NULL) {*index = slot;}
+    conc_publish(arr);
+    return true;
+}
+
+
+
+void* get_concurrent_array_element(pConcurrent_Arr_t a, size_t index) {
+
+    pConcurrent_Obj_t arr = (pConcurrent_Obj_t) a;
+    if (!arr) {return NULL;}
+
+    //Indexes past the claimed slots have no segment (and the biggest ones would wrap in conc_segment)
+    if (index >= atomic_load_explicit(&arr->claimed, memory_order_acquire)) {return NULL;}
+    if (conc_slot_state(arr, index) != SLOT_READY) {return NULL;}
+
+    size_t offset;
+    size_t seg_idx = conc_segment(index, &offset);
+    char* seg = atomic_load_explicit(&arr->seg[seg_idx], memory_order_acquire);
+    return seg + offset * arr->el_size;
+}
+
+
+size_t get_concurrent_array_count(pConcurrent_Arr_t a) {
+
+    pConcurrent_Obj_t arr = (pConcurrent_Obj_t) a;
+    if (!arr) {return 0;}
+    return conc_publish(arr);
+}
+
+
+size_t get_concurrent_array_claimed(pConcurrent_Arr_t a) {
+
+    pConcurrent_Obj_t arr = (pConcurrent_Obj_t) a;
+    if (!arr) {return 0;}
+    return atomic_load_explicit(&arr->claimed, memory_order_acquire);
+}
@@ -0,0 +1,42 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_array.h - Header for the Concurrent Dynamic Array data structure
+//
+//	  Any number of threads can append at the same time without locking. Storage is split
+//	  into segments that double in size, so elements never move once they are written.
+//
+//	  Readers only see the published elements: the longest run from index 0 where every
+//	  element has been completely written.
+//
+#ifndef CONCURRENT_ARRAY_HEADER
+#define CONCURRENT_ARRAY_HEADER
+
+#include <stddef.h>	/* For size_t */
+#include <stdbool.h>
+#include "dynamic_array.h"	/* For Free_Func_t */
+
+typedef void *pConcurrent_Arr_t;
+
+
+//Not thread-safe: nothing else can be using the array while it is freed
+pConcurrent_Arr_t new_concurrent_array(size_t el_size);
+void free_concurrent_array(pConcurrent_Arr_t arr, Free_Func_t func);
+
+
+//Thread-safe append (lock-free)
+//  If index is not NULL, it gets the index the element was written to
+//  If memory runs out, the claimed slot stays empty and publishing stops there for good
+bool add_concurrent_array_element(pConcurrent_Arr_t arr, const void* new, size_t* index);
+
+//Returns NULL if the element has not been published yet
+//  The pointer stays valid until the array is freed
+void* get_concurrent_array_element(pConcurrent_Arr_t arr, size_t index);
+
+//Number of published elements (every index below this can be read)
+size_t get_concurrent_array_count(pConcurrent_Arr_t arr);
+
+//Number of slots claimed by writers, including any that are still being written
+size_t get_concurrent_array_claimed(pConcurrent_Arr_t arr);
+
+#endif // CONCURRENT_ARRAY_HEADER Included
@@ -0,0 +1,359 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_dyll.c - Implementation for the Concurrent Dynamic Linked-List Array
+//
+#include "concurrent_dyll.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define CACHE_LINE      64
+#define SLOT_IDLE       SIZE_MAX    // Reader slot that is not in use
+
+
+//Single item in the list
+//  Items are linked in before they are visible, and stay linked after they are deleted,
+//  so a reader can tell from birth and death whether the item is part of its version
+typedef struct CDyLL_Node {
+    _Atomic(struct CDyLL_Node*) next;
+    struct CDyLL_Node* pre;         // Writer only
+    struct CDyLL_Node* garbage;     // Writer only: next item waiting to be unlinked or freed
+
+    size_t birth;                   // Version that added this item
+    atomic_size_t death;            // Version that deleted it (0 while alive)
+    size_t retired;                 // Version it was unlinked at
+
+    size_t len;
+    _Alignas(max_align_t) unsigned char data[];
+} CDyLL_Node_t, *pCDyLL_Node_t;
+
+//Each active reader holds the version it is reading, on its own cache line
+typedef struct {
+    atomic_size_t version;
+    char pad[CACHE_LINE - sizeof(atomic_size_t)];
+} CDyLL_Slot_t, *pCDyLL_Slot_t;
+
+
+// Private Concurrent DyLL object
+typedef struct {
+    atomic_size_t version;          // Latest version of the list
+    pCDyLL_Node_t head;             // Sentinel (never deleted)
+    atomic_size_t count;            // Items alive in the latest version
+
+    pthread_mutex_t lock;           // Everything below is only used by writers
+    pCDyLL_Node_t tail;             // Last linked item (alive or not)
+    pCDyLL_Node_t dead;             // Deleted, but still linked
+    pCDyLL_Node_t retired;          // Unlinked, waiting to be freed
+
+    size_t max_readers;
+    pCDyLL_Slot_t slots;
+} CDyLL_Obj_t, *pCDyLL_Obj_t;
+
+
+
+//--------------------- Private Functions --------------------------------
+
+//Oldest version any reader is still using (or the latest version if there are no readers)
+static size_t cdyll_oldest_reader(pCDyLL_Obj_t list) {
+    size_t oldest = atomic_load(&list->version);
+    size_t i;
+    for (i = 0; i < list->max_readers; ++i) {
+        size_t v = atomic_load(&list->slots[i].version);
+        if (v < oldest) {oldest = v;}
+    }
+    return oldest;
+}
+
+
+//Unlink deleted items that no reader can see anymore, and free unlinked items nobody can be standing on
+//  Must hold the writer lock
+static void cdyll_reclaim(pCDyLL_Obj_t list) {
+    size_t oldest = cdyll_oldest_reader(list);
+    pCDyLL_Node_t* link;
+
+    //Free first, so nothing unlinked in this pass gets freed by mistake
+    link = &list->retired;
+    while (*link) {
+        pCDyLL_Node_t node = *link;
+        if (node->retired <= oldest) {
+            *link = node->garbage;
+            free(node);
+        } else {
+            link = &node->garbage;
+        }
+    }
+
+    //Every reader is at or after the version that deleted these, so they all skip over them
+    size_t stamp = atomic_load_explicit(&list->version, memory_order_relaxed) + 1;
+    bool unlinked = false;
+
+    link = &list->dead;
+    while (*link) {
+        pCDyLL_Node_t node = *link;
+        if (atomic_load_explicit(&node->death, memory_order_relaxed) > oldest) {
+            link = &node->garbage;
+            continue;
+        }
+        *link = node->garbage;
+
+        pCDyLL_Node_t next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        atomic_store_explicit(&node->pre->next, next, memory_order_release);
+        if (next) {next->pre = node->pre;}
+        else {list->tail = node->pre;}
+
+        //Readers already standing on it can still move on, so it can't be freed yet
+        node->retired = stamp;
+        node->garbage = list->retired;
+        list->retired = node;
+        unlinked = true;
+    }
+
+    //Readers that start from here on can't reach anything that was unlinked
+    if (unlinked) {atomic_store(&list->version, stamp);}
+}
+
+
+//Item at index in the latest version (or NULL)
+static pCDyLL_Node_t cdyll_get_index(pCDyLL_Obj_t list, size_t index) {
+    pCDyLL_Node_t node = atomic_load_explicit(&list->head->next, memory_order_relaxed);
+    while (node) {
+        if (atomic_load_explicit(&node->death, memory_order_relaxed) == 0) {
+            if (index == 0) {break;}
+            --index;
+        }
+        node = atomic_load_explicit(&node->next, memory_order_relaxed);
+    }
+    return node;
+}
+
+
+//Link a new item in after "after" (any item that is still linked, or the head)
+//  Must hold the writer lock
+static bool cdyll_insert_after(pCDyLL_Obj_t list, pCDyLL_Node_t after, const void* element, size_t el_size) {
+    pCDyLL_Node_t node = malloc(sizeof(CDyLL_Node_t) + el_size);
+    if (!node) {return false;}
+
+    size_t version = atomic_load_explicit(&list->version, memory_order_relaxed) + 1;
+    memcpy(node->data, element, el_size);
+    node->len = el_size;
+    node->birth = version;
+    node->garbage = NULL;
+    atomic_init(&node->death, 0);
+
+    pCDyLL_Node_t next = atomic_load_explicit(&after->next, memory_order_relaxed);
+    atomic_init(&node->next, next);
+    node->pre = after;
+    if (next) {next->pre = node;}
+    else {list->tail = node;}
+
+    //Readers on older versions might walk into it, but they skip it because of birth
+    atomic_store_explicit(&after->next, node, memory_order_release);
+    atomic_store_explicit(&list->version, version, memory_order_release);
+
+    atomic_fetch_add_explicit(&list->count, 1, memory_order_relaxed);
+    cdyll_reclaim(list);
+    return true;
+}
+
+
+//Visible to a reader at this version?
+static inline bool cdyll_visible(pCDyLL_Node_t node, size_t version) {
+    if (node->birth > version) {return false;}
+    size_t death = atomic_load_explicit(&node->death, memory_order_acquire);
+    return ((death == 0) || (death > version));
+}
+
+
+
+
+//--------------------- Public Functions --------------------------------
+
+pCDyLL_Arr_t new_concurrent_dyll(size_t max_readers) {
+    if (max_readers == 0) {return NULL;}
+
+    pCDyLL_Obj_t list = calloc(1, sizeof(CDyLL_Obj_t));
+    if (!list) {return NULL;}
+
+    list->slots = aligned_alloc(CACHE_LINE, max_readers * sizeof(CDyLL_Slot_t));
+    if (!list->slots) {free(list); return NULL;}
+
+    size_t i;
+    list->max_readers = max_readers;
+    for (i = 0; i < max_readers; ++i) {atomic_init(&list->slots[i].version, SLOT_IDLE);}
+
+    list->head = calloc(1, sizeof(CDyLL_Node_t));
+    if (!list->head) {free(list->slots); free(list); return NULL;}
+
+    atomic_init(&list->version, 1);
+    atomic_init(&list->count, 0);
+    atomic_init(&list->head->next, NULL);
+    atomic_init(&list->head->death, 0);
+    list->tail = list->head;
+    pthread_mutex_init(&list->lock, NULL);
+
+    return (pCDyLL_Arr_t) list;
+}
+
+
+void free_concurrent_dyll(pCDyLL_Arr_t l) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return;}
+
+    //Everything that is unlinked is on the retired list, and everything else is still linked
+    pCDyLL_Node_t node = list->retired;
+    while (node) {
+        pCDyLL_Node_t next = node->garbage;
+        free(node);
+        node = next;
+    }
+
+    node = atomic_load_explicit(&list->head->next, memory_order_relaxed);
+    while (node) {
+        pCDyLL_Node_t next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        free(node);
+        node = next;
+    }
+
+    pthread_mutex_destroy(&list->lock);
+    free(list->head);
+    free(list->slots);
+    free(list);
+}
+
+
+
+
+bool cdyll_add_element(pCDyLL_Arr_t l, const void* element, size_t el_size) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return false;}
+
+    pthread_mutex_lock(&list->lock);
+    bool ok = cdyll_insert_after(list, list->tail, element, el_size);
+    pthread_mutex_unlock(&list->lock);
+    return ok;
+}
+
+
+bool cdyll_add_element_before(pCDyLL_Arr_t l, size_t index, const void* element, size_t el_size) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return false;}
+
+    bool ok = false;
+    pthread_mutex_lock(&list->lock);
+    pCDyLL_Node_t node = cdyll_get_index(list, index);
+    if (node) {ok = cdyll_insert_after(list, node->pre, element, el_size);}
+    pthread_mutex_unlock(&list->lock);
+    return ok;
+}
+
+
+bool cdyll_add_element_after(pCDyLL_Arr_t l, size_t index, const void* element, size_t el_size) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return false;}
+
+    bool ok = false;
+    pthread_mutex_lock(&list->lock);
+    pCDyLL_Node_t node = cdyll_get_index(list, index);
+    if (node) {ok = cdyll_insert_after(list, node, element, el_size);}
+    pthread_mutex_unlock(&list->lock);
+    return ok;
+}
+
+
+bool cdyll_delete_element(pCDyLL_Arr_t l, size_t index) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return false;}
+
+    pthread_mutex_lock(&list->lock);
+    pCDyLL_Node_t node = cdyll_get_index(list, index);
+    if (!node) {pthread_mutex_unlock(&list->lock); return false;}
+
+    //Only marked for now: readers on older versions still see it
+    size_t version = atomic_load_explicit(&list->version, memory_order_relaxed) + 1;
+    atomic_store_explicit(&node->death, version, memory_order_release);
+    atomic_store_explicit(&list->version, version, memory_order_release);
+
+    node->garbage = list->dead;
+    list->dead = node;
+    atomic_fetch_sub_explicit(&list->count, 1, memory_order_relaxed);
+
+    cdyll_reclaim(list);
+    pthread_mutex_unlock(&list->lock);
+    return true;
+}
+
+
+void cdyll_collect(pCDyLL_Arr_t l) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return;}
+
+    pthread_mutex_lock(&list->lock);
+    cdyll_reclaim(list);
+    pthread_mutex_unlock(&list->lock);
+}
+
+
+size_t cdyll_get_count(pCDyLL_Arr_t l) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!list) {return -1;}
+    return atomic_load_explicit(&list->count, memory_order_relaxed);
+}
+
+
+
+
+bool cdyll_read_begin(pCDyLL_Arr_t l, pCDyLL_Reader_t reader) {
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) l;
+    if (!(list && reader)) {return false;}
+
+    //Claim a free slot
+    size_t i, version = atomic_load(&list->version);
+    for (i = 0; i < list->max_readers; ++i) {
+        size_t idle = SLOT_IDLE;
+        if (atomic_compare_exchange_strong(&list->slots[i].version, &idle, version)) {break;}
+    }
+    if (i == list->max_readers) {return false;}
+
+    //A writer could have moved on (and missed this slot) before it was claimed,
+    //  so keep going until the slot matches the latest version
+    size_t latest;
+    while ((latest = atomic_load(&list->version)) != version) {
+        version = latest;
+        atomic_store(&list->slots[i].version, version);
+    }
+
+    reader->list = l;
+    reader->version = version;
+    reader->slot = i;
+    reader->node = list->head;
+    return true;
+}
+
+
+const void* cdyll_read_next(pCDyLL_Reader_t reader, size_t* len) {
+    if (!(reader && reader->node)) {return NULL;}
+
+    pCDyLL_Node_t node = (pCDyLL_Node_t) reader->node;
+    do {
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+    } while (node && !cdyll_visible(node, reader->version));
+
+    reader->node = node;
+    if (!node) {return NULL;}
+
+    if (len != NULL) {*len = node->len;}
+    return node->data;
+}
+
+
+void cdyll_read_end(pCDyLL_Reader_t reader) {
+    if (!(reader && reader->list)) {return;}
+
+    pCDyLL_Obj_t list = (pCDyLL_Obj_t) reader->list;
+    atomic_store(&list->slots[reader->slot].version, SLOT_IDLE);
+    reader->list = NULL;
+    reader->node = NULL;
+}
@@ -0,0 +1,60 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	concurrent_dyll.h - Header for the Concurrent Dynamic Linked-List Array
+//
+//	  A DyLL that any number of threads can read while writers add and delete items.
+//	  Writers take turns behind a lock, but readers never block or take a lock.
+//
+//	  Every change bumps a version number. A reader pins the current version when it starts,
+//	  and only sees the list exactly as it was at that version, no matter what writers do
+//	  in the meantime. Deleted items are only freed once no reader can still be looking at them.
+//
+#ifndef CONCURRENT_DYLL_HEADER
+#define CONCURRENT_DYLL_HEADER
+
+#include <stddef.h>	/* For size_t */
+#include <stdbool.h>
+
+typedef void *pCDyLL_Arr_t;
+
+//State for one reader (owned by the caller)
+typedef struct {
+    pCDyLL_Arr_t list;
+    size_t version;     // Private: version of the list being read
+    size_t slot;        // Private: reader slot that pins the version
+    void* node;         // Private: current position
+} CDyLL_Reader_t, *pCDyLL_Reader_t;
+
+
+//max_readers is the most readers that can be active at the same time
+//  Not thread-safe: nothing else can be using the list while it is freed
+pCDyLL_Arr_t new_concurrent_dyll(size_t max_readers);
+void free_concurrent_dyll(pCDyLL_Arr_t list);
+
+
+//Writers (thread-safe, one at a time)
+//  Indexes count the items in the latest version of the list
+bool cdyll_add_element(pCDyLL_Arr_t list, const void* element, size_t el_size);
+bool cdyll_add_element_before(pCDyLL_Arr_t list, size_t index, const void* element, size_t el_size);
+bool cdyll_add_element_after(pCDyLL_Arr_t list, size_t index, const void* element, size_t el_size);
+bool cdyll_delete_element(pCDyLL_Arr_t list, size_t index);
+
+//Free anything deleted that readers are done with (writers already do this on every change)
+void cdyll_collect(pCDyLL_Arr_t list);
+
+//Number of items in the latest version of the list
+size_t cdyll_get_count(pCDyLL_Arr_t list);
+
+
+//Readers (thread-safe, lock-free)
+//  begin fails if max_readers are already active
+bool cdyll_read_begin(pCDyLL_Arr_t list, pCDyLL_Reader_t reader);
+
+//Returns the next item in the pinned version (or NULL at the end)
+//  The pointer stays valid until cdyll_read_end()
+const void* cdyll_read_next(pCDyLL_Reader_t reader, size_t* len);
+
+void cdyll_read_end(pCDyLL_Reader_t reader);
+
+#endif // CONCURRENT_DYLL_HEADER Included
@@ -5,22 +5,96 @@
 //
 #include "dyll_array.h"
 #include <string.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DYLL_WRITEV
+#include <errno.h>
+#include <limits.h>		/* For IOV_MAX */
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
 
 #define INIT_ITEMS	10		//List starts with 10 items every time
-#define ITEMS_INC	10		//List adds 10 items for every realloc
+#define ITEMS_INC	10		//List grows by half (but at least 10 items) for every realloc
 
 #define LL_NULL ((size_t) -1)
 
 
 
+#define TREE_SEED 2463534242u	//Starting state for the tree priorities
+
+//Small payloads are packed into pages, one page list per size class
+#define SLAB_CLASSES	8
+#define SLAB_ALIGN		16			//Every class is a multiple of this (like malloc)
+#define SLAB_MAX		256			//Anything bigger gets its own malloc
+#define SLAB_PAGE		4096		//Bytes per page, including the header
+
+//Unrolled lists pack several elements into each block instead
+#define UNROLL_DEFAULT	512			//Bytes per block if the caller doesn't pick
+#define UNROLL_MIN		64
+#define UNROLL_SLOT		16			//One slot in the block header for every 16 bytes of block
+#define UNROLL_ALIGN	8			//Every element starts on a multiple of this
+#define UNROLL_ROUND(x)	(((x) + UNROLL_ALIGN - 1) & ~((size_t) UNROLL_ALIGN - 1))
+
+#define STREAM_CHUNK	4096		//Smallest buffer added by the byte stream functions
+
+
 //Single item in the doubly-linked list
+//	Every item in use is also a node in a tree ordered by list position (an implicit treap),
+//	which finds the item at any index in O(log n)
 typedef struct {
 	void* data;			//Malloc'd buffer that actually stores the data
 	size_t len;			//How long is this segment of data
+	size_t head;		//Bytes drained off the front of the buffer (data points past them)
+	size_t room;		//Unused bytes in the buffer after the data (for appending in place)
 	size_t next;
 	size_t pre;
+
+	size_t left;		//Tree links (items before and after this one)
+	size_t right;
+	size_t parent;
+	size_t size;		//Number of items in this subtree
+	uint32_t prio;		//Random heap priority, keeps the tree balanced
+
+	uint8_t kind;		//Where the payload came from (DATA_ types below)
+	union {
+		size_t heap_slot;	//Where a DATA_HEAP or DATA_ADOPTED payload is listed in the heap table
+		size_t items;		//Number of elements in a DATA_BLOCK
+	};
 } DyLL_LL_t, *pDyLL_LL_t;
 
+//Types of payload storage
+#define DATA_SLAB		0	// Slot inside of a slab page
+#define DATA_HEAP		1	// Too big for the slab, so allocated on its own
+#define DATA_ADOPTED	2	// Buffer handed over by the caller (freed with free_func if there is one)
+#define DATA_BLOCK		3	// Block of several elements (only used by unrolled lists)
+
+
+//Every item in an unrolled list points to one of these, with the elements packed in after the header
+//	Element i starts where element i-1 ends (rounded up to UNROLL_ALIGN), so only the ends are stored
+typedef struct {
+	uint32_t count;		//Elements in the block
+	uint32_t max;		//Most elements the header has room for
+	uint32_t capacity;	//Bytes in the data area
+	uint32_t end[];		//Where each element ends in the data area
+} Unrolled_Block_t, *pUnrolled_Block_t;
+
+
+//Header at the start of every slab page
+typedef union Slab_Page {
+	union Slab_Page* next;
+	max_align_t align;	//Keeps the slots after it aligned
+} Slab_Page_t, *pSlab_Page_t;
+
+//All pages for a single size class
+typedef struct {
+	void* free;			//Free list, threaded through the slots
+	char* bump;			//Slots in the newest page that have never been used
+	char* bump_end;
+	pSlab_Page_t pages;
+} Slab_Class_t, *pSlab_Class_t;
+
 //The private DyLL object
 typedef struct {
 	size_t start_item;		// Where does the linked list array start?
@@ -32,6 +106,18 @@ typedef struct {
 
 	size_t items_alloc;		// Total number of items allocated in ll
 	pDyLL_LL_t ll;			// Linked list of all entries in this array
+	size_t root;			// Root of the position tree
+	uint32_t seed;			// State for the tree priorities
+	size_t version;			// Bumped whenever an item is linked or unlinked (for cursors)
+
+	Slab_Class_t slab[SLAB_CLASSES];	// Storage for small payloads
+	size_t* heap;			// Entries with a payload allocated on its own (not in the slab)
+	size_t heap_count;
+	size_t heap_alloc;
+
+	pAllocator_t alloc;		// Where all memory comes from (NULL for malloc/free)
+	DyLL_Free_Func_t free_func;	// Releases adopted buffers (NULL to use alloc)
+	size_t block_size;		// Bytes per block in an unrolled list (0 for one element per item)
 } DyLL_Arr_Obj_t, *pDyLL_Arr_Obj_t;
 
 
@@ -41,7 +127,13 @@ static void dyll_free_entry(pDyLL_Arr_Obj_t dyll, size_t entry);
 static bool dyll_add_chunk(pDyLL_Arr_Obj_t dyll);
 static size_t dyll_next_entry(pDyLL_Arr_Obj_t dyll);
 static bool dyll_copy_data(pDyLL_Arr_Obj_t dyll, size_t index, void* data, size_t el_size) ;
+static bool dyll_adopt_data(pDyLL_Arr_Obj_t dyll, size_t index, void* data, size_t el_size);
 static void dyll_free_data(pDyLL_Arr_Obj_t dyll, size_t index);
+static void* dyll_detach_data(pDyLL_Arr_Obj_t dyll, size_t index);
+static void dyll_release_data(pDyLL_Arr_Obj_t dyll);
+static void dyll_reset_entries(pDyLL_Arr_Obj_t dyll);
+static void dyll_link(pDyLL_Arr_Obj_t dyll, size_t entry, size_t after);
+static void dyll_unlink(pDyLL_Arr_Obj_t dyll, size_t entry);
 
 
 
@@ -49,18 +141,23 @@ static void dyll_free_data(pDyLL_Arr_Obj_t dyll, size_t index);
 
 
 //Add another chunk of memory to the internal linked-list array
+//	Grows geometrically, so adding n items only copies the array O(log n) times
 static bool dyll_add_chunk(pDyLL_Arr_Obj_t dyll) {
-	void* new = realloc((void*) dyll->ll, dyll->items_alloc + ITEMS_INC);
+	size_t inc = dyll->items_alloc / 2;
+	if (inc < ITEMS_INC) {inc = ITEMS_INC;}
+
+	void* new = mem_realloc(dyll->alloc, (void*) dyll->ll,
+		dyll->items_alloc * sizeof(DyLL_LL_t), (dyll->items_alloc + inc) * sizeof(DyLL_LL_t));
 	if (!new) {return false; /* Realloc should not fail*/ }
 	dyll->ll = new;
 
 	//Also update the indexes
 	size_t i;
-	for (i = dyll->items_alloc; i < dyll->items_alloc + ITEMS_INC; ++i) {
+	for (i = dyll->items_alloc; i < dyll->items_alloc + inc; ++i) {
 		dyll->ll[i].next = i+1;
 	}
 	dyll->ll[dyll->items_alloc].pre = LL_NULL;
-	dyll->items_alloc += ITEMS_INC;
+	dyll->items_alloc += inc;
 	return true;
 }
 
@@ -88,317 +185,2002 @@ static void dyll_free_entry(pDyLL_Arr_Obj_t dyll, size_t entry) {
 }
 
 
-//Returns LL_NULL on failure
-static size_t dyll_get_index(pDyLL_Arr_Obj_t dyll, size_t index) {
-	
-	//Traverse along the array until the index is found
-	size_t idx = dyll->start_item;
-	while((idx != LL_NULL) && (index > 0)) {
-		idx = dyll->ll[idx].next;
-		--index;
-	}
 
-	return idx;
+//Number of elements in the subtree at entry (which can be LL_NULL)
+static inline size_t tree_size(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	return (entry == LL_NULL) ? 0 : dyll->ll[entry].size;
 }
 
+//Number of elements in a single entry (always 1, unless the list is unrolled)
+static inline size_t tree_weight(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	return dyll->block_size ? dyll->ll[entry].items : 1;
+}
 
-static bool dyll_copy_data(pDyLL_Arr_Obj_t dyll, size_t index, void* data, size_t el_size) {
+//Xorshift, so every list gets the same sequence of priorities
+static uint32_t tree_random(pDyLL_Arr_Obj_t dyll) {
+	uint32_t x = dyll->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	dyll->seed = x;
+	return x;
+}
 
-	dyll->ll[index].data = malloc(el_size);
-	if (!dyll->ll[index].data) {return false; /* Malloc should not fail */ }
+//Rotate entry above its parent, keeping the in-order (list) order the same
+static void tree_rotate_up(pDyLL_Arr_Obj_t dyll, size_t x) {
+	pDyLL_LL_t ll = dyll->ll;
+	size_t p = ll[x].parent;
+	size_t g = ll[p].parent;
 
-	memcpy(dyll->ll[index].data,data,el_size);
-	dyll->ll[index].len = el_size;
-	dyll->bytes+=el_size; 
+	if (ll[p].left == x) {
+		ll[p].left = ll[x].right;
+		if (ll[x].right != LL_NULL) {ll[ll[x].right].parent = p;}
+		ll[x].right = p;
+	} else {
+		ll[p].right = ll[x].left;
+		if (ll[x].left != LL_NULL) {ll[ll[x].left].parent = p;}
+		ll[x].left = p;
+	}
 
-	return true;
-}
+	ll[p].parent = x;
+	ll[x].parent = g;
+	if (g == LL_NULL) {dyll->root = x;}
+	else if (ll[g].left == p) {ll[g].left = x;}
+	else {ll[g].right = x;}
 
-static void dyll_free_data(pDyLL_Arr_Obj_t dyll, size_t idx) {
-	if (dyll->ll[idx].data) {free(dyll->ll[idx].data);}
-	dyll->bytes-=dyll->ll[idx].len;
+	ll[x].size = ll[p].size;
+	ll[p].size = tree_weight(dyll,p) + tree_size(dyll,ll[p].left) + tree_size(dyll,ll[p].right);
 }
 
+//Add an entry to the tree, after it has been linked into the list
+//	The new entry always fits as a leaf next to one of its list neighbors
+static void tree_insert(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	pDyLL_LL_t ll = dyll->ll;
+	size_t pre = ll[entry].pre;
+	size_t next = ll[entry].next;
+	size_t parent = LL_NULL;
+
+	ll[entry].left = LL_NULL;
+	ll[entry].right = LL_NULL;
+	ll[entry].size = tree_weight(dyll,entry);
+	ll[entry].prio = tree_random(dyll);
+
+	if ((pre != LL_NULL) && (ll[pre].right == LL_NULL)) {
+		parent = pre;
+		ll[pre].right = entry;
+	} else if (next != LL_NULL) {
+		parent = next;			//Must be the first item of pre's right subtree
+		ll[next].left = entry;
+	} else {
+		dyll->root = entry;
+	}
+	ll[entry].parent = parent;
 
+	size_t i;
+	for (i = parent; i != LL_NULL; i = ll[i].parent) {ll[i].size+=ll[entry].size;}
 
+	while ((ll[entry].parent != LL_NULL) && (ll[ll[entry].parent].prio < ll[entry].prio)) {
+		tree_rotate_up(dyll,entry);
+	}
+}
 
+//Remove an entry from the tree (rotating it down until it has at most one child)
+static void tree_remove(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	pDyLL_LL_t ll = dyll->ll;
 
+	while ((ll[entry].left != LL_NULL) && (ll[entry].right != LL_NULL)) {
+		size_t l = ll[entry].left, r = ll[entry].right;
+		tree_rotate_up(dyll, (ll[l].prio > ll[r].prio) ? l : r);
+	}
 
+	size_t child = (ll[entry].left != LL_NULL) ? ll[entry].left : ll[entry].right;
+	size_t parent = ll[entry].parent;
+	if (child != LL_NULL) {ll[child].parent = parent;}
 
+	if (parent == LL_NULL) {dyll->root = child;}
+	else if (ll[parent].left == entry) {ll[parent].left = child;}
+	else {ll[parent].right = child;}
 
-//--------------------- Public Functions --------------------------------
+	size_t i, weight = tree_weight(dyll,entry);
+	for (i = parent; i != LL_NULL; i = ll[i].parent) {ll[i].size-=weight;}
+}
 
-pDyLL_Arr_t new_dyll_array() {
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) calloc(1,sizeof(DyLL_Arr_Obj_t));
-	if (!dyll) {return NULL;}
+//Position of (the first element of) an entry in the list, found by walking up the tree
+static size_t tree_rank(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	size_t rank = tree_size(dyll,dyll->ll[entry].left);
+	while (dyll->ll[entry].parent != LL_NULL) {
+		size_t parent = dyll->ll[entry].parent;
+		if (dyll->ll[parent].right == entry) {rank += tree_size(dyll,dyll->ll[parent].left) + tree_weight(dyll,parent);}
+		entry = parent;
+	}
+	return rank;
+}
 
-	dyll->ll = (pDyLL_LL_t) malloc(INIT_ITEMS*sizeof(DyLL_LL_t));
-	if (!dyll->ll) {free(dyll); return NULL;}
+//An unrolled block changed how many elements it holds, so fix the sizes of every subtree it is in
+static void tree_resize(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	size_t old = dyll->ll[entry].items;
+	size_t items = ((pUnrolled_Block_t) dyll->ll[entry].data)->count;
+	dyll->ll[entry].items = items;
 
-	//Initialize the list to a default free list (of 10 items)
+	for (; entry != LL_NULL; entry = dyll->ll[entry].parent) {
+		dyll->ll[entry].size = dyll->ll[entry].size - old + items;
+	}
+}
+
+
+//Put every entry back on the free list (without touching their data)
+static void dyll_reset_entries(pDyLL_Arr_Obj_t dyll) {
 	size_t i;
-	dyll->items_alloc = INIT_ITEMS;
-	dyll->start_item = LL_NULL;
-	dyll->end_item = LL_NULL;
 	for (i = 0; i < dyll->items_alloc; ++i) {
 		dyll->ll[i].next = i+1;
 	}
 
-	return (pDyLL_Arr_t) dyll;
+	dyll->start_item = LL_NULL;
+	dyll->end_item = LL_NULL;
+	dyll->root = LL_NULL;
+	dyll->next_item = 0;
+	dyll->items_inuse = 0;
+	dyll->version+=1;
 }
 
 
+//Split a tree into its first k items (left) and everything else (right)
+//	Only used when every entry holds a single element
+static void tree_split(pDyLL_Arr_Obj_t dyll, size_t root, size_t k, size_t* left, size_t* right) {
+	pDyLL_LL_t ll = dyll->ll;
+	if (root == LL_NULL) {*left = LL_NULL; *right = LL_NULL; return;}
+
+	size_t l, r;
+	size_t left_size = tree_size(dyll,ll[root].left);
+	if (k <= left_size) {
+		tree_split(dyll, ll[root].left, k, &l, &r);
+		ll[root].left = r;
+		if (r != LL_NULL) {ll[r].parent = root;}
+		*left = l;
+		*right = root;
+	} else {
+		tree_split(dyll, ll[root].right, k - left_size - 1, &l, &r);
+		ll[root].right = l;
+		if (l != LL_NULL) {ll[l].parent = root;}
+		*left = root;
+		*right = r;
+	}
+	ll[root].size = 1 + tree_size(dyll,ll[root].left) + tree_size(dyll,ll[root].right);
 
-void free_dyll_array(pDyLL_Arr_t d) {
+	//The caller attaches these wherever they go
+	if (*left != LL_NULL) {ll[*left].parent = LL_NULL;}
+	if (*right != LL_NULL) {ll[*right].parent = LL_NULL;}
+}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return;}
+//Join two trees, with every item in left coming before right
+static size_t tree_merge(pDyLL_Arr_Obj_t dyll, size_t left, size_t right) {
+	pDyLL_LL_t ll = dyll->ll;
+	if (left == LL_NULL) {return right;}
+	if (right == LL_NULL) {return left;}
+
+	size_t root;
+	if (ll[left].prio > ll[right].prio) {
+		size_t child = tree_merge(dyll, ll[left].right, right);
+		ll[left].right = child;
+		ll[child].parent = left;
+		root = left;
+	} else {
+		size_t child = tree_merge(dyll, left, ll[right].left);
+		ll[right].left = child;
+		ll[child].parent = right;
+		root = right;
+	}
 
-	if (dyll->ll) {
+	ll[root].size = tree_weight(dyll,root) + tree_size(dyll,ll[root].left) + tree_size(dyll,ll[root].right);
+	ll[root].parent = LL_NULL;
+	return root;
+}
 
-		//Release all of the internal linked-list buffers:
-		size_t i = dyll->start_item;
-		while(i != LL_NULL) {
-			pDyLL_LL_t ll = (dyll->ll + i);
-			if (ll->data) {free(ll->data); ll->data = NULL;}
-			i = ll->next;
+//Build a tree from n entries that are already in list order (order[i], or just i if order is NULL)
+//	This is a Cartesian tree on the existing priorities, built in one pass with a stack
+//	While building, size holds the first position in each subtree
+//	stack must have room for n entries. Returns the root
+static size_t tree_build(pDyLL_Arr_Obj_t dyll, const size_t* order, size_t n, size_t* stack) {
+	pDyLL_LL_t ll = dyll->ll;
+	if (n == 0) {return LL_NULL;}
+
+	size_t top = 0, i, pos = 0;		//pos is the number of elements before entry i
+	for (i = 0; i < n; ++i) {
+		size_t entry = order ? order[i] : i;
+		size_t last = LL_NULL;
+		while ((top > 0) && (ll[stack[top-1]].prio < ll[entry].prio)) {
+			last = stack[--top];
+			ll[last].size = pos - ll[last].size;	//Subtree is done, so turn it into a count
 		}
 
-		free(dyll->ll);
+		ll[entry].left = last;
+		ll[entry].right = LL_NULL;
+		ll[entry].size = (last != LL_NULL) ? (pos - ll[last].size) : pos;
+		if (last != LL_NULL) {ll[last].parent = entry;}
+
+		if (top > 0) {
+			ll[stack[top-1]].right = entry;
+			ll[entry].parent = stack[top-1];
+		} else {
+			ll[entry].parent = LL_NULL;
+		}
+		stack[top++] = entry;
+		pos += tree_weight(dyll,entry);
 	}
 
-	free(dyll);
+	//Everything left on the stack runs to the end of the list
+	size_t root = stack[0];
+	while (top > 0) {
+		size_t entry = stack[--top];
+		ll[entry].size = pos - ll[entry].size;
+	}
+	return root;
 }
 
 
+//Find the entry holding an element, and where the element is inside of it (offset can be NULL)
+//	Returns LL_NULL on failure
+static size_t dyll_find(pDyLL_Arr_Obj_t dyll, size_t index, size_t* offset) {
 
+	//Walk down the tree, using the subtree sizes to pick a side
+	size_t idx = dyll->root;
+	while(idx != LL_NULL) {
+		size_t left = tree_size(dyll,dyll->ll[idx].left);
+		size_t weight = tree_weight(dyll,idx);
+		if ((index >= left) && (index - left < weight)) {index -= left; break;}
 
+		if (index < left) {
+			idx = dyll->ll[idx].left;
+		} else {
+			index -= left + weight;
+			idx = dyll->ll[idx].right;
+		}
+	}
 
+	if (offset != NULL) {*offset = index;}
+	return idx;
+}
 
+//Returns LL_NULL on failure
+static size_t dyll_get_index(pDyLL_Arr_Obj_t dyll, size_t index) {
+	return dyll_find(dyll,index,NULL);
+}
 
+//Number of elements in the list
+static inline size_t dyll_count(pDyLL_Arr_Obj_t dyll) {
+	return tree_size(dyll,dyll->root);
+}
 
 
-bool dyll_add_element(pDyLL_Arr_t d, void* element, size_t el_size) {
-	
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return false;}
+//Insert an entry into the list after another one (or at the start if after is LL_NULL)
+static void dyll_link(pDyLL_Arr_Obj_t dyll, size_t entry, size_t after) {
+	size_t before = (after == LL_NULL) ? dyll->start_item : dyll->ll[after].next;
 
-	size_t next = dyll_next_entry(dyll);
-	if (next == LL_NULL) {return false;}
+	dyll->ll[entry].pre = after;
+	dyll->ll[entry].next = before;
 
-	//Copy the data into this item
-	if (!dyll_copy_data(dyll,next,element,el_size)) {
-		dyll_free_entry(dyll,next);
-		return false;
-	}
+	if (after != LL_NULL) {dyll->ll[after].next = entry;}
+	else {dyll->start_item = entry;}
 
-	//Now add to the "inuse" list
-	size_t last = dyll->end_item;
-	if (last == LL_NULL) {
-		//Special case for an empty list
-		dyll->start_item = next;
-		dyll->ll[next].pre = LL_NULL;
+	if (before != LL_NULL) {dyll->ll[before].pre = entry;}
+	else {dyll->end_item = entry;}
+
+	tree_insert(dyll,entry);
+	dyll->version+=1;
+}
+
+//Take an entry out of the list (but does not free it)
+static void dyll_unlink(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	tree_remove(dyll,entry);
+	dyll->version+=1;
+
+	if (dyll->ll[entry].next != LL_NULL) {
+		dyll->ll[dyll->ll[entry].next].pre = dyll->ll[entry].pre;
 	} else {
-		dyll->ll[last].next = next;
-		dyll->ll[next].pre = last;
+		dyll->end_item = dyll->ll[entry].pre;
 	}
-	dyll->ll[next].next = LL_NULL;
-	dyll->end_item = next;
 
-	return true;
+	if (dyll->ll[entry].pre != LL_NULL) {
+		dyll->ll[dyll->ll[entry].pre].next = dyll->ll[entry].next;
+	} else {
+		dyll->start_item = dyll->ll[entry].next;
+	}
 }
 
 
-bool dyll_add_element_before(pDyLL_Arr_t d, size_t index, void* element, size_t el_size) {
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return false;}
 
-	size_t idx = dyll_get_index(dyll,index);
-	if (idx == LL_NULL) {return false;}
+//Bytes per slot in each size class
+static const size_t slab_class_size[SLAB_CLASSES] = {16, 32, 48, 64, 96, 128, 192, 256};
 
-	size_t next = dyll_next_entry(dyll);
-	if (next == LL_NULL) {return false;}
+//Smallest class that fits len (which must be <= SLAB_MAX)
+static inline size_t slab_class(size_t len) {
+	static const unsigned char by_units[(SLAB_MAX / SLAB_ALIGN) + 1] =
+		{0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7};
+	return by_units[(len + SLAB_ALIGN - 1) / SLAB_ALIGN];
+}
 
-	//Copy the data into this item
-	if (!dyll_copy_data(dyll,next,element,el_size)) {
-		dyll_free_entry(dyll,next);
-		return false;
+static void* slab_alloc(pDyLL_Arr_Obj_t dyll, size_t len) {
+	pSlab_Class_t cls = &dyll->slab[slab_class(len)];
+	size_t size = slab_class_size[slab_class(len)];
+
+	if (cls->free) {
+		void* slot = cls->free;
+		cls->free = *((void**) slot);
+		return slot;
 	}
 
-	//Update the linked list	
-	if (dyll->ll[idx].pre != LL_NULL) {
-		dyll->ll[dyll->ll[idx].pre].next = next;
-	} else {
-		dyll->start_item = next;
+	//Start a new page once the current one is used up
+	if ((size_t) (cls->bump_end - cls->bump) < size) {
+		pSlab_Page_t page = (pSlab_Page_t) mem_alloc(dyll->alloc, SLAB_PAGE);
+		if (!page) {return NULL;}
+
+		page->next = cls->pages;
+		cls->pages = page;
+		cls->bump = (char*) (page + 1);
+		cls->bump_end = ((char*) page) + SLAB_PAGE;
 	}
 
-	dyll->ll[next].pre = dyll->ll[idx].pre;
-	dyll->ll[next].next = idx;
-	dyll->ll[idx].pre = next;
+	void* slot = cls->bump;
+	cls->bump += size;
+	return slot;
+}
+
+static void slab_free(pDyLL_Arr_Obj_t dyll, void* slot, size_t len) {
+	pSlab_Class_t cls = &dyll->slab[slab_class(len)];
+	*((void**) slot) = cls->free;
+	cls->free = slot;
+}
+
+
+//Keep track of payloads that were allocated on their own, so they can be freed without walking the list
+//	Make sure there is room for extra more entries in the table
+static bool heap_reserve(pDyLL_Arr_Obj_t dyll, size_t extra) {
+	if (dyll->heap_count + extra <= dyll->heap_alloc) {return true;}
+
+	size_t new_alloc = dyll->heap_alloc ? (dyll->heap_alloc * 2) : INIT_ITEMS;
+	if (new_alloc < dyll->heap_count + extra) {new_alloc = dyll->heap_count + extra;}
 
+	size_t* new = mem_realloc(dyll->alloc, dyll->heap,
+		dyll->heap_alloc * sizeof(size_t), new_alloc * sizeof(size_t));
+	if (!new) {return false;}
+	dyll->heap = new;
+	dyll->heap_alloc = new_alloc;
 	return true;
 }
 
+static bool heap_add(pDyLL_Arr_Obj_t dyll, size_t idx) {
+	if (!heap_reserve(dyll, 1)) {return false;}
 
-bool dyll_add_element_after(pDyLL_Arr_t d, size_t index, void* element, size_t el_size) {
+	dyll->ll[idx].heap_slot = dyll->heap_count;
+	dyll->heap[dyll->heap_count++] = idx;
+	return true;
+}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return false;}
+//Remove an entry from the heap table (moving the last one into its place)
+static void heap_remove(pDyLL_Arr_Obj_t dyll, size_t idx) {
+	size_t slot = dyll->ll[idx].heap_slot;
+	size_t last = dyll->heap[--dyll->heap_count];
 
-	size_t idx = dyll_get_index(dyll,index);
-	if (idx == LL_NULL) {return false;}
+	dyll->heap[slot] = last;
+	dyll->ll[last].heap_slot = slot;
+}
 
-	size_t next = dyll_next_entry(dyll);
-	if (next == LL_NULL) {return false;}
 
-	//Copy the data into this item
-	if (!dyll_copy_data(dyll,next,element,el_size)) {
-		dyll_free_entry(dyll,next);
-		return false;
-	}
-	
-	//Update the linked list
-	dyll->ll[next].next = dyll->ll[idx].next;
-	dyll->ll[next].pre = idx;
-	dyll->ll[idx].next = next;
+//The whole buffer behind a payload, including anything drained off the front or still unused at the end
+static inline void* payload_base(pDyLL_LL_t ll) {
+	return ((char*) ll->data) - ll->head;
+}
+
+static inline size_t payload_size(pDyLL_LL_t ll) {
+	return ll->head + ll->len + ll->room;
+}
 
-	if (dyll->ll[next].next != LL_NULL) {
-		dyll->ll[dyll->ll[next].next].pre = next;
+
+//Release a payload that is not in the slab
+static void heap_free(pDyLL_Arr_Obj_t dyll, void* data, size_t len, uint8_t kind) {
+	if ((kind == DATA_ADOPTED) && dyll->free_func) {dyll->free_func(data, len);}
+	else {mem_free(dyll->alloc, data, len);}
+}
+
+
+static bool dyll_copy_data(pDyLL_Arr_Obj_t dyll, size_t index, void* data, size_t el_size) {
+
+	if (el_size <= SLAB_MAX) {
+		dyll->ll[index].data = slab_alloc(dyll, el_size);
+		if (!dyll->ll[index].data) {return false; /* Malloc should not fail */ }
+		dyll->ll[index].kind = DATA_SLAB;
 	} else {
-		dyll->end_item = next;
+		dyll->ll[index].data = mem_alloc(dyll->alloc, el_size);
+		if (!dyll->ll[index].data) {return false; /* Malloc should not fail */ }
+
+		if (!heap_add(dyll, index)) {
+			mem_free(dyll->alloc, dyll->ll[index].data, el_size);
+			return false;
+		}
+		dyll->ll[index].kind = DATA_HEAP;
 	}
 
+	memcpy(dyll->ll[index].data,data,el_size);
+	dyll->ll[index].len = el_size;
+	dyll->ll[index].head = 0;
+	dyll->ll[index].room = 0;
+	dyll->bytes+=el_size; 
+
 	return true;
 }
 
+//Take ownership of a buffer, without copying it
+static bool dyll_adopt_data(pDyLL_Arr_Obj_t dyll, size_t index, void* data, size_t el_size) {
+	if (!heap_add(dyll, index)) {return false;}
 
+	dyll->ll[index].data = data;
+	dyll->ll[index].len = el_size;
+	dyll->ll[index].head = 0;
+	dyll->ll[index].room = 0;
+	dyll->ll[index].kind = DATA_ADOPTED;
+	dyll->bytes+=el_size;
+	return true;
+}
 
+static void dyll_free_data(pDyLL_Arr_Obj_t dyll, size_t idx) {
+	pDyLL_LL_t ll = dyll->ll + idx;
 
-bool dyll_delete_element(pDyLL_Arr_t d, size_t index) {
+	if (ll->kind == DATA_SLAB) {
+		slab_free(dyll, payload_base(ll), payload_size(ll));
+	} else {
+		heap_remove(dyll, idx);
+		heap_free(dyll, payload_base(ll), payload_size(ll), ll->kind);
+	}
+	dyll->bytes-=ll->len;
+}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return false;}
+//Take the payload out of an entry, as a buffer the caller can free with the allocator
+//	Slab payloads have to be copied out, since they live inside of a page (adopted ones are handed back as-is)
+//	So do payloads that were drained or appended to, since the buffer is no longer exactly len bytes
+//	Returns NULL (and leaves the entry alone) if the copy fails
+static void* dyll_detach_data(pDyLL_Arr_Obj_t dyll, size_t idx) {
+	pDyLL_LL_t ll = dyll->ll + idx;
+	size_t len = ll->len;
+	void* buf = ll->data;
+
+	if ((ll->kind == DATA_SLAB) || ll->head || ll->room) {
+		buf = mem_alloc(dyll->alloc, len ? len : 1);
+		if (!buf) {return NULL;}
+		memcpy(buf, ll->data, len);
+
+		if (ll->kind == DATA_SLAB) {slab_free(dyll, payload_base(ll), payload_size(ll));}
+		else {
+			heap_remove(dyll, idx);
+			heap_free(dyll, payload_base(ll), payload_size(ll), ll->kind);
+		}
+	} else {
+		heap_remove(dyll, idx);
+	}
 
-	size_t idx = dyll_get_index(dyll,index);
-	if (idx == LL_NULL) {return false;}
+	dyll->ll[idx].data = NULL;
+	dyll->bytes-=len;
+	return buf;
+}
 
-	//Release any stored data
-	dyll_free_data(dyll,idx);
+//Free every payload at once: one free per page (plus one per payload outside of the slab)
+//	Unrolled lists have nothing but blocks, which are freed one at a time
+static void dyll_release_data(pDyLL_Arr_Obj_t dyll) {
+	size_t i;
+	if (dyll->block_size) {
+		for (i = dyll->start_item; i != LL_NULL; i = dyll->ll[i].next) {
+			mem_free(dyll->alloc, dyll->ll[i].data, dyll->ll[i].len);
+		}
+	}
 
-	//Patch up the linked list
-	if (dyll->ll[idx].next != LL_NULL) {
-		dyll->ll[dyll->ll[idx].next].pre = dyll->ll[idx].pre;
-	} else {
-		dyll->end_item = dyll->ll[idx].pre;
+	for (i = 0; i < SLAB_CLASSES; ++i) {
+		pSlab_Page_t page = dyll->slab[i].pages;
+		while (page) {
+			pSlab_Page_t next = page->next;
+			mem_free(dyll->alloc, page, SLAB_PAGE);
+			page = next;
+		}
 	}
+	memset(dyll->slab, 0, sizeof(dyll->slab));
 
-	if (dyll->ll[idx].pre != LL_NULL) {
-		dyll->ll[dyll->ll[idx].pre].next = dyll->ll[idx].next;
-	} else {
-		dyll->start_item = dyll->ll[idx].next;
+	for (i = 0; i < dyll->heap_count; ++i) {
+		pDyLL_LL_t ll = dyll->ll + dyll->heap[i];
+		heap_free(dyll, payload_base(ll), payload_size(ll), ll->kind);
 	}
+	dyll->heap_count = 0;
+	dyll->bytes = 0;
+}
 
-	dyll_free_entry(dyll,idx);
 
-	return true;
+
+
+//Bytes before the data area of a block
+static inline size_t block_header(size_t max) {
+	return UNROLL_ROUND(sizeof(Unrolled_Block_t) + max * sizeof(uint32_t));
 }
 
+static inline char* block_data(pUnrolled_Block_t block) {
+	return ((char*) block) + block_header(block->max);
+}
 
+static inline size_t block_start(pUnrolled_Block_t block, size_t i) {
+	return (i > 0) ? UNROLL_ROUND(block->end[i-1]) : 0;
+}
 
-const void* dyll_get_element(pDyLL_Arr_t d, size_t index, size_t* len) {
+static inline size_t block_used(pUnrolled_Block_t block) {
+	return (block->count > 0) ? block->end[block->count-1] : 0;
+}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return NULL;}
+//Is there room for one more element, anywhere in the block?
+static inline bool block_fits(pUnrolled_Block_t block, size_t len) {
+	return (block->count < block->max) && (UNROLL_ROUND(block_used(block)) + UNROLL_ROUND(len) <= block->capacity);
+}
 
-	size_t idx = dyll_get_index(dyll,index);
-	if (idx == LL_NULL) {return NULL;}
+//Is there room for every element of src on the end of dst?
+static inline bool block_fits_all(pUnrolled_Block_t dst, pUnrolled_Block_t src) {
+	return (dst->count + src->count <= dst->max) &&
+		(UNROLL_ROUND(block_used(dst)) + block_used(src) <= dst->capacity);
+}
 
-	void* data = dyll->ll[idx].data;
-	if (len != NULL) {*len = dyll->ll[idx].len;}
-	return data;
+//Bytes of elements in the block (not counting the padding between them)
+static size_t block_payload(pUnrolled_Block_t block) {
+	size_t i, total = 0;
+	for (i = 0; i < block->count; ++i) {total += block->end[i] - block_start(block,i);}
+	return total;
 }
 
+//Slide everything from element i onwards over, then copy the new element into the gap
+static void block_insert(pUnrolled_Block_t block, size_t i, const void* element, size_t len) {
+	char* data = block_data(block);
+	size_t start = block_start(block,i);
 
-void* dyll_copy_element(pDyLL_Arr_t dyll, size_t index, size_t* len) {
+	if (i < block->count) {
+		size_t shift = UNROLL_ROUND(start + len) - start;
+		memmove(data + start + shift, data + start, block_used(block) - start);
 
-	size_t temp_len;
-	const void* data = dyll_get_element(dyll,index,&temp_len);
-	if (!data) {return NULL;}
+		size_t j;
+		for (j = block->count; j > i; --j) {block->end[j] = block->end[j-1] + shift;}
+	}
 
-	void* new_buf = malloc(temp_len);
-	if (!new_buf) {return NULL;}
+	memcpy(data + start, element, len);
+	block->end[i] = start + len;
+	block->count+=1;
+}
 
-	//Copy the data
-	memcpy(new_buf,data,temp_len);
-	if (len != NULL) {*len = temp_len;}
-	return new_buf;
+static void block_remove(pUnrolled_Block_t block, size_t i) {
+	char* data = block_data(block);
+	size_t start = block_start(block,i);
+
+	if (i + 1 < block->count) {
+		size_t next = block_start(block,i+1);
+		memmove(data + start, data + next, block_used(block) - next);
+
+		size_t j;
+		for (j = i + 1; j < block->count; ++j) {block->end[j-1] = block->end[j] - (next - start);}
+	}
+	block->count-=1;
 }
 
 
-void* dyll_flush_element(pDyLL_Arr_t d, size_t index, size_t* len) {
+//Payload of element off inside of an entry (off is always 0 unless the list is unrolled)
+static inline void* dyll_element(pDyLL_Arr_Obj_t dyll, size_t entry, size_t off, size_t* len) {
+	pDyLL_LL_t ll = dyll->ll + entry;
+	if (ll->kind != DATA_BLOCK) {*len = ll->len; return ll->data;}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return NULL;}
+	pUnrolled_Block_t block = (pUnrolled_Block_t) ll->data;
+	size_t start = block_start(block,off);
+	*len = block->end[off] - start;
+	return block_data(block) + start;
+}
 
-	size_t idx = dyll_get_index(dyll,index);
-	if (idx == LL_NULL) {return NULL;}
+//Move to the next (or previous) element, which sets entry to LL_NULL after the end
+static inline void dyll_step(pDyLL_Arr_Obj_t dyll, size_t* entry, size_t* off) {
+	if (*off + 1 < tree_weight(dyll,*entry)) {*off+=1; return;}
+	*entry = dyll->ll[*entry].next;
+	*off = 0;
+}
 
-	void* temp_buf = dyll->ll[idx].data;
-	if (len != NULL) {*len = dyll->ll[idx].len;}
-	
-	//Delete the data (should NOT fail)
-	dyll->ll[idx].data = NULL;	//Don't free the old data
-	dyll_delete_element(d,index);	
+static inline void dyll_step_back(pDyLL_Arr_Obj_t dyll, size_t* entry, size_t* off) {
+	if (*off > 0) {*off-=1; return;}
+	*entry = dyll->ll[*entry].pre;
+	*off = (*entry != LL_NULL) ? (tree_weight(dyll,*entry) - 1) : 0;
+}
 
-	return temp_buf;
+
+
+
+//Link in a new (empty) block after an entry, big enough for an element of len bytes
+//	Elements that don't fit in a normal block get a block of their own, just big enough to hold them
+static size_t unrolled_new_block(pDyLL_Arr_Obj_t dyll, size_t after, size_t len) {
+	size_t max = dyll->block_size / UNROLL_SLOT;
+	size_t capacity = dyll->block_size - block_header(max);
+	if (UNROLL_ROUND(len) > capacity) {
+		max = 1;
+		capacity = UNROLL_ROUND(len);
+	}
+
+	size_t entry = dyll_next_entry(dyll);
+	if (entry == LL_NULL) {return LL_NULL;}
+
+	size_t bytes = block_header(max) + capacity;
+	pUnrolled_Block_t block = (pUnrolled_Block_t) mem_alloc(dyll->alloc, bytes);
+	if (!block) {dyll_free_entry(dyll,entry); return LL_NULL;}
+
+	block->count = 0;
+	block->max = (uint32_t) max;
+	block->capacity = (uint32_t) capacity;
+
+	dyll->ll[entry].data = block;
+	dyll->ll[entry].len = bytes;
+	dyll->ll[entry].kind = DATA_BLOCK;
+	dyll->ll[entry].items = 0;
+	dyll_link(dyll,entry,after);
+	return entry;
 }
 
+//Unlink a block and free it, along with anything still in it
+static void unrolled_free_block(pDyLL_Arr_Obj_t dyll, size_t entry) {
+	pUnrolled_Block_t block = (pUnrolled_Block_t) dyll->ll[entry].data;
+	dyll->bytes-=block_payload(block);
 
+	dyll_unlink(dyll,entry);
+	mem_free(dyll->alloc, block, dyll->ll[entry].len);
+	dyll_free_entry(dyll,entry);
+}
 
+//Move the elements [first, count) of one block onto the end of another (which must have room)
+//	Both blocks start elements on the same alignment, so the bytes can be copied in one go
+static void unrolled_move(pDyLL_Arr_Obj_t dyll, size_t from, size_t first, size_t to) {
+	pUnrolled_Block_t src = (pUnrolled_Block_t) dyll->ll[from].data;
+	pUnrolled_Block_t dst = (pUnrolled_Block_t) dyll->ll[to].data;
 
+	size_t base = UNROLL_ROUND(block_used(dst));
+	size_t start = block_start(src,first);
+	memcpy(block_data(dst) + base, block_data(src) + start, block_used(src) - start);
 
+	size_t i;
+	for (i = first; i < src->count; ++i) {dst->end[dst->count++] = (uint32_t) (src->end[i] - start + base);}
+	src->count = (uint32_t) first;
 
-void* dyll_flush_array(pDyLL_Arr_t d, size_t* total_len) {
+	tree_resize(dyll,from);
+	tree_resize(dyll,to);
+}
 
-	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
-	if (!dyll) {return NULL;}
 
-	//Build the new buffer
-	size_t total = 0;
-	void* new_buf = malloc(dyll->bytes);
-	if (!new_buf) {return NULL;}
+//Add a copy of element so that it ends up at index (which can be the count, to add to the end)
+static bool unrolled_insert(pDyLL_Arr_Obj_t dyll, size_t index, const void* element, size_t el_size) {
+	if (el_size > UINT32_MAX - dyll->block_size) {return false;}		//Offsets in a block are 32 bits
 
-	//Copy everything out of here
-	void* temp_buf = new_buf;
-	while(1) {
-		size_t temp_len;
-		void* buf = dyll_flush_element(d,0, &temp_len);
-		if (!buf) {break;}
-		
-		memcpy(temp_buf,buf,temp_len);
-		free(buf);
-		total+=temp_len;
-		temp_buf = (void*) (((char*) temp_buf)+temp_len);	//Cast to byte array
+	size_t entry, off;
+	if (index == dyll_count(dyll)) {
+		entry = dyll->end_item;
+		off = (entry != LL_NULL) ? dyll->ll[entry].items : 0;
+	} else {
+		entry = dyll_find(dyll,index,&off);
+		if (entry == LL_NULL) {return false;}
 	}
 
-	if (total_len != NULL) {*total_len = total;}
-	return new_buf;
+	//Between two blocks, either one will do
+	if ((entry != LL_NULL) && (off == 0)) {
+		size_t pre = dyll->ll[entry].pre;
+		if ((pre != LL_NULL) && block_fits(dyll->ll[pre].data, el_size)) {entry = pre; off = dyll->ll[pre].items;}
+	} else if ((entry != LL_NULL) && (off == dyll->ll[entry].items) && !block_fits(dyll->ll[entry].data, el_size)) {
+		size_t next = dyll->ll[entry].next;
+		if ((next != LL_NULL) && block_fits(dyll->ll[next].data, el_size)) {entry = next; off = 0;}
+	}
+
+	//Inserting inside of a full block splits it in half, until there is room (or the element is at one of its ends)
+	while ((entry != LL_NULL) && (off > 0) && (off < dyll->ll[entry].items) && !block_fits(dyll->ll[entry].data, el_size)) {
+		size_t half = dyll->ll[entry].items / 2;
+		size_t right = unrolled_new_block(dyll,entry,0);
+		if (right == LL_NULL) {return false;}
+
+		unrolled_move(dyll,entry,half,right);
+		if (off > half) {entry = right; off -= half;}
+	}
+
+	//Otherwise, the element gets a block of its own
+	if ((entry == LL_NULL) || !block_fits(dyll->ll[entry].data, el_size)) {
+		size_t after = (entry == LL_NULL) ? dyll->end_item : ((off == 0) ? dyll->ll[entry].pre : entry);
+		entry = unrolled_new_block(dyll,after,el_size);
+		if (entry == LL_NULL) {return false;}
+		off = 0;
+	}
+
+	block_insert(dyll->ll[entry].data, off, element, el_size);
+	tree_resize(dyll,entry);
+	dyll->bytes+=el_size;
+	dyll->version+=1;
+	return true;
 }
 
 
+static bool unrolled_delete(pDyLL_Arr_Obj_t dyll, size_t index) {
+	size_t off;
+	size_t entry = dyll_find(dyll,index,&off);
+	if (entry == LL_NULL) {return false;}
 
+	size_t len;
+	dyll_element(dyll,entry,off,&len);
 
+	pUnrolled_Block_t block = (pUnrolled_Block_t) dyll->ll[entry].data;
+	block_remove(block,off);
+	tree_resize(dyll,entry);
+	dyll->bytes-=len;
+	dyll->version+=1;
 
+	if (block->count == 0) {unrolled_free_block(dyll,entry); return true;}
 
-size_t dyll_get_count(pDyLL_Arr_t dyll) {
-	if (!dyll) {return -1;}
-	return ((pDyLL_Arr_Obj_t) dyll)->items_inuse;
+	//Once a block is down to a quarter full, try to fold it into one of its neighbors
+	if ((block->count * 4 > block->max) && (UNROLL_ROUND(block_used(block)) * 4 > block->capacity)) {return true;}
+
+	size_t next = dyll->ll[entry].next;
+	size_t pre = dyll->ll[entry].pre;
+	if ((next != LL_NULL) && block_fits_all(block, dyll->ll[next].data)) {
+		unrolled_move(dyll,next,0,entry);
+		unrolled_free_block(dyll,next);
+	} else if ((pre != LL_NULL) && block_fits_all(dyll->ll[pre].data, block)) {
+		unrolled_move(dyll,entry,0,pre);
+		unrolled_free_block(dyll,entry);
+	}
+	return true;
 }
 
 
-size_t dyll_get_size(pDyLL_Arr_t dyll) {
-	if (!dyll) {return -1;}
-	return ((pDyLL_Arr_Obj_t) dyll)->bytes;
+
+
+
+
+
+
+//--------------------- Public Functions --------------------------------
+
+//Shared by every constructor (block_size is 0 for a normal list)
+static pDyLL_Arr_Obj_t dyll_create(pAllocator_t alloc, size_t block_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) mem_alloc(alloc, sizeof(DyLL_Arr_Obj_t));
+	if (!dyll) {return NULL;}
+	memset(dyll, 0, sizeof(DyLL_Arr_Obj_t));
+	dyll->alloc = alloc;
+	dyll->block_size = block_size;
+
+	dyll->ll = (pDyLL_LL_t) mem_alloc(alloc, INIT_ITEMS*sizeof(DyLL_LL_t));
+	if (!dyll->ll) {mem_free(alloc, dyll, sizeof(DyLL_Arr_Obj_t)); return NULL;}
+
+	//Initialize the list to a default free list (of 10 items)
+	dyll->items_alloc = INIT_ITEMS;
+	dyll->seed = TREE_SEED;
+	dyll_reset_entries(dyll);
+
+	return dyll;
+}
+
+
+pDyLL_Arr_t new_dyll_array() {
+	return new_dyll_array_alloc(NULL);
+}
+
+
+pDyLL_Arr_t new_dyll_array_alloc(pAllocator_t alloc) {
+	return (pDyLL_Arr_t) dyll_create(alloc, 0);
+}
+
+
+pDyLL_Arr_t new_unrolled_dyll_array(size_t block_size) {
+	return new_unrolled_dyll_array_alloc(block_size, NULL);
+}
+
+
+pDyLL_Arr_t new_unrolled_dyll_array_alloc(size_t block_size, pAllocator_t alloc) {
+	if (block_size == 0) {block_size = UNROLL_DEFAULT;}
+	if (block_size < UNROLL_MIN) {block_size = UNROLL_MIN;}
+	if (block_size > UINT32_MAX / 2) {return NULL;}		//Offsets in a block are 32 bits
+
+	return (pDyLL_Arr_t) dyll_create(alloc, UNROLL_ROUND(block_size));
+}
+
+
+
+void free_dyll_array(pDyLL_Arr_t d) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return;}
+
+	if (dyll->ll) {
+
+		//Release all of the internal linked-list buffers (page by page)
+		dyll_release_data(dyll);
+		mem_free(dyll->alloc, dyll->heap, dyll->heap_alloc * sizeof(size_t));
+		mem_free(dyll->alloc, dyll->ll, dyll->items_alloc * sizeof(DyLL_LL_t));
+	}
+
+	mem_free(dyll->alloc, dyll, sizeof(DyLL_Arr_Obj_t));
+}
+
+
+
+
+
+
+
+
+
+bool dyll_add_element(pDyLL_Arr_t d, void* element, size_t el_size) {
+	
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if (dyll->block_size) {return unrolled_insert(dyll,dyll_count(dyll),element,el_size);}
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	//Copy the data into this item
+	if (!dyll_copy_data(dyll,next,element,el_size)) {
+		dyll_free_entry(dyll,next);
+		return false;
+	}
+
+	//Now add to the "inuse" list
+	dyll_link(dyll,next,dyll->end_item);
+	return true;
+}
+
+
+bool dyll_add_element_before(pDyLL_Arr_t d, size_t index, void* element, size_t el_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if (dyll->block_size) {return (index < dyll_count(dyll)) && unrolled_insert(dyll,index,element,el_size);}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return false;}
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	//Copy the data into this item
+	if (!dyll_copy_data(dyll,next,element,el_size)) {
+		dyll_free_entry(dyll,next);
+		return false;
+	}
+
+	//Update the linked list	
+	dyll_link(dyll,next,dyll->ll[idx].pre);
+	return true;
+}
+
+
+bool dyll_add_element_after(pDyLL_Arr_t d, size_t index, void* element, size_t el_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if (dyll->block_size) {return (index < dyll_count(dyll)) && unrolled_insert(dyll,index+1,element,el_size);}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return false;}
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	//Copy the data into this item
+	if (!dyll_copy_data(dyll,next,element,el_size)) {
+		dyll_free_entry(dyll,next);
+		return false;
+	}
+	
+	//Update the linked list
+	dyll_link(dyll,next,idx);
+	return true;
+}
+
+
+
+
+//Shared by the adopt functions: take over buffer and link it in after the entry "after"
+static bool dyll_adopt_after(pDyLL_Arr_Obj_t dyll, size_t after, void* buffer, size_t el_size) {
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	if (!dyll_adopt_data(dyll,next,buffer,el_size)) {
+		dyll_free_entry(dyll,next);
+		return false;
+	}
+
+	dyll_link(dyll,next,after);
+	return true;
+}
+
+
+//Unrolled lists keep every element inside of a block, so the buffer is copied in and then released
+static bool unrolled_adopt(pDyLL_Arr_Obj_t dyll, size_t index, void* buffer, size_t el_size) {
+	if (!unrolled_insert(dyll,index,buffer,el_size)) {return false;}
+	heap_free(dyll, buffer, el_size, DATA_ADOPTED);
+	return true;
+}
+
+
+bool dyll_adopt_element(pDyLL_Arr_t d, void* buffer, size_t el_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && buffer)) {return false;}
+	if (dyll->block_size) {return unrolled_adopt(dyll,dyll_count(dyll),buffer,el_size);}
+
+	return dyll_adopt_after(dyll,dyll->end_item,buffer,el_size);
+}
+
+
+bool dyll_adopt_element_before(pDyLL_Arr_t d, size_t index, void* buffer, size_t el_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && buffer)) {return false;}
+	if (dyll->block_size) {return (index < dyll_count(dyll)) && unrolled_adopt(dyll,index,buffer,el_size);}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return false;}
+
+	return dyll_adopt_after(dyll,dyll->ll[idx].pre,buffer,el_size);
+}
+
+
+bool dyll_adopt_element_after(pDyLL_Arr_t d, size_t index, void* buffer, size_t el_size) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && buffer)) {return false;}
+	if (dyll->block_size) {return (index < dyll_count(dyll)) && unrolled_adopt(dyll,index+1,buffer,el_size);}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return false;}
+
+	return dyll_adopt_after(dyll,idx,buffer,el_size);
+}
+
+
+void dyll_set_free_func(pDyLL_Arr_t d, DyLL_Free_Func_t func) {
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (dyll) {dyll->free_func = func;}
+}
+
+
+
+bool dyll_delete_element(pDyLL_Arr_t d, size_t index) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if (dyll->block_size) {return unrolled_delete(dyll,index);}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return false;}
+
+	//Release any stored data
+	dyll_free_data(dyll,idx);
+
+	//Patch up the linked list
+	dyll_unlink(dyll,idx);
+	dyll_free_entry(dyll,idx);
+
+	return true;
+}
+
+
+
+const void* dyll_get_element(pDyLL_Arr_t d, size_t index, size_t* len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return NULL;}
+
+	size_t off;
+	size_t idx = dyll_find(dyll,index,&off);
+	if (idx == LL_NULL) {return NULL;}
+
+	size_t temp_len;
+	void* data = dyll_element(dyll,idx,off,&temp_len);
+	if (len != NULL) {*len = temp_len;}
+	return data;
+}
+
+
+void* dyll_copy_element(pDyLL_Arr_t dyll, size_t index, size_t* len) {
+
+	size_t temp_len;
+	const void* data = dyll_get_element(dyll,index,&temp_len);
+	if (!data) {return NULL;}
+
+	void* new_buf = mem_alloc(((pDyLL_Arr_Obj_t) dyll)->alloc, temp_len);
+	if (!new_buf) {return NULL;}
+
+	//Copy the data
+	memcpy(new_buf,data,temp_len);
+	if (len != NULL) {*len = temp_len;}
+	return new_buf;
+}
+
+
+void* dyll_flush_element(pDyLL_Arr_t d, size_t index, size_t* len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return NULL;}
+
+	//Elements of an unrolled list are always inside of a block
+	if (dyll->block_size) {
+		void* buf = dyll_copy_element(d,index,len);
+		if (buf) {unrolled_delete(dyll,index);}
+		return buf;
+	}
+
+	size_t idx = dyll_get_index(dyll,index);
+	if (idx == LL_NULL) {return NULL;}
+
+	size_t temp_len = dyll->ll[idx].len;
+	void* temp_buf = dyll_detach_data(dyll,idx);
+	if (!temp_buf) {return NULL;}
+	if (len != NULL) {*len = temp_len;}
+	
+	//Delete the entry, but not the data
+	dyll_unlink(dyll,idx);
+	dyll_free_entry(dyll,idx);
+
+	return temp_buf;
+}
+
+
+
+
+
+
+void* dyll_flush_array(pDyLL_Arr_t d, size_t* total_len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return NULL;}
+
+	//Build the new buffer
+	size_t total = 0;
+	void* new_buf = mem_alloc(dyll->alloc, dyll->bytes);
+	if (!new_buf) {return NULL;}
+
+	//Copy everything out of here
+	void* temp_buf = new_buf;
+	size_t i, off = 0;
+	for (i = dyll->start_item; i != LL_NULL; dyll_step(dyll,&i,&off)) {
+		size_t temp_len;
+		const void* data = dyll_element(dyll,i,off,&temp_len);
+		memcpy(temp_buf,data,temp_len);
+		total+=temp_len;
+		temp_buf = (void*) (((char*) temp_buf)+temp_len);	//Cast to byte array
+	}
+
+	//Then empty the list all at once
+	dyll_release_data(dyll);
+	dyll_reset_entries(dyll);
+
+	if (total_len != NULL) {*total_len = total;}
+	return new_buf;
+}
+
+
+
+
+
+
+size_t dyll_get_count(pDyLL_Arr_t dyll) {
+	if (!dyll) {return -1;}
+	return dyll_count((pDyLL_Arr_Obj_t) dyll);
+}
+
+
+size_t dyll_get_size(pDyLL_Arr_t dyll) {
+	if (!dyll) {return -1;}
+	return ((pDyLL_Arr_Obj_t) dyll)->bytes;
+}
+
+
+
+
+
+
+
+
+
+//--------------------- Cursors --------------------------------
+
+//In debug builds, a cursor fails once the list is changed by anything other than itself
+#ifndef NDEBUG
+#define CURSOR_STALE(dyll,cursor) ((cursor)->stamp != (dyll)->version)
+#else
+#define CURSOR_STALE(dyll,cursor) false
+#endif
+
+//Offset of a cursor that moved off the front (one past the end always has an offset of 0)
+#define CURSOR_OFF_FRONT	1
+
+
+static bool dyll_cursor_set(pDyLL_Arr_t d, size_t entry, size_t off, pDyLL_Cursor_t cursor) {
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && cursor)) {return false;}
+
+	cursor->dyll = d;
+	cursor->entry = entry;
+	cursor->offset = (entry != LL_NULL) ? off : 0;
+	cursor->stamp = dyll->version;
+	return (entry != LL_NULL);
+}
+
+bool dyll_cursor_begin(pDyLL_Arr_t dyll, pDyLL_Cursor_t cursor) {
+	if (!dyll) {return false;}
+	return dyll_cursor_set(dyll, ((pDyLL_Arr_Obj_t) dyll)->start_item, 0, cursor);
+}
+
+bool dyll_cursor_end(pDyLL_Arr_t d, pDyLL_Cursor_t cursor) {
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+
+	size_t entry = dyll->end_item;
+	return dyll_cursor_set(d, entry, (entry != LL_NULL) ? (tree_weight(dyll,entry) - 1) : 0, cursor);
+}
+
+bool dyll_cursor_at(pDyLL_Arr_t dyll, size_t index, pDyLL_Cursor_t cursor) {
+	if (!dyll) {return false;}
+
+	size_t off;
+	size_t entry = dyll_find((pDyLL_Arr_Obj_t) dyll,index,&off);
+	return dyll_cursor_set(dyll, entry, off, cursor);
+}
+
+
+
+bool dyll_cursor_valid(pDyLL_Cursor_t cursor) {
+	if (!(cursor && cursor->dyll)) {return false;}
+	if (CURSOR_STALE((pDyLL_Arr_Obj_t) cursor->dyll, cursor)) {return false;}
+	return (cursor->entry != LL_NULL);
+}
+
+
+bool dyll_cursor_next(pDyLL_Cursor_t cursor) {
+	if (!dyll_cursor_valid(cursor)) {return false;}
+	dyll_step((pDyLL_Arr_Obj_t) cursor->dyll, &cursor->entry, &cursor->offset);
+	return (cursor->entry != LL_NULL);
+}
+
+bool dyll_cursor_prev(pDyLL_Cursor_t cursor) {
+	if (!dyll_cursor_valid(cursor)) {return false;}
+	dyll_step_back((pDyLL_Arr_Obj_t) cursor->dyll, &cursor->entry, &cursor->offset);
+	if (cursor->entry == LL_NULL) {cursor->offset = CURSOR_OFF_FRONT;}
+	return (cursor->entry != LL_NULL);
+}
+
+
+const void* dyll_cursor_get(pDyLL_Cursor_t cursor, size_t* len) {
+	if (!dyll_cursor_valid(cursor)) {return NULL;}
+
+	size_t temp_len;
+	const void* data = dyll_element((pDyLL_Arr_Obj_t) cursor->dyll, cursor->entry, cursor->offset, &temp_len);
+	if (len != NULL) {*len = temp_len;}
+	return data;
+}
+
+size_t dyll_cursor_index(pDyLL_Cursor_t cursor) {
+	if (!dyll_cursor_valid(cursor)) {return -1;}
+	return tree_rank((pDyLL_Arr_Obj_t) cursor->dyll, cursor->entry) + cursor->offset;
+}
+
+
+
+//Shared by both inserts: add a copy of element right after the entry "after"
+static bool dyll_cursor_add(pDyLL_Cursor_t cursor, size_t after, void* element, size_t el_size) {
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) cursor->dyll;
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	if (!dyll_copy_data(dyll,next,element,el_size)) {
+		dyll_free_entry(dyll,next);
+		return false;
+	}
+
+	dyll_link(dyll,next,after);
+	cursor->stamp = dyll->version;
+	return true;
+}
+
+//In an unrolled list, elements can move to another block whenever one is added or deleted,
+//	so the cursor is found again by its index (index can be the count, for past the end)
+static void dyll_cursor_seek(pDyLL_Cursor_t cursor, size_t index) {
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) cursor->dyll;
+	cursor->entry = dyll_find(dyll,index,&cursor->offset);
+	if (cursor->entry == LL_NULL) {cursor->offset = 0;}
+	cursor->stamp = dyll->version;
+}
+
+
+bool dyll_cursor_insert_before(pDyLL_Cursor_t cursor, void* element, size_t el_size) {
+	if (!(cursor && cursor->dyll)) {return false;}
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) cursor->dyll;
+	if (CURSOR_STALE(dyll,cursor)) {return false;}
+
+	//Nothing comes before the front
+	if ((cursor->entry == LL_NULL) && (cursor->offset == CURSOR_OFF_FRONT)) {return false;}
+
+	if (dyll->block_size) {
+		bool end = (cursor->entry == LL_NULL);
+		size_t index = end ? dyll_count(dyll) : dyll_cursor_index(cursor);
+		if (!unrolled_insert(dyll,index,element,el_size)) {return false;}
+		dyll_cursor_seek(cursor, end ? dyll_count(dyll) : index + 1);
+		return true;
+	}
+
+	//Past the end, so add to the end of the list
+	size_t after = (cursor->entry == LL_NULL) ? dyll->end_item : dyll->ll[cursor->entry].pre;
+	return dyll_cursor_add(cursor,after,element,el_size);
+}
+
+bool dyll_cursor_insert_after(pDyLL_Cursor_t cursor, void* element, size_t el_size) {
+	if (!dyll_cursor_valid(cursor)) {return false;}
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) cursor->dyll;
+	if (dyll->block_size) {
+		size_t index = dyll_cursor_index(cursor);
+		if (!unrolled_insert(dyll,index+1,element,el_size)) {return false;}
+		dyll_cursor_seek(cursor,index);
+		return true;
+	}
+
+	return dyll_cursor_add(cursor,cursor->entry,element,el_size);
+}
+
+
+bool dyll_cursor_delete(pDyLL_Cursor_t cursor) {
+	if (!dyll_cursor_valid(cursor)) {return false;}
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) cursor->dyll;
+	if (dyll->block_size) {
+		size_t index = dyll_cursor_index(cursor);
+		unrolled_delete(dyll,index);
+		dyll_cursor_seek(cursor,index);
+		return true;
+	}
+
+	size_t idx = cursor->entry;
+	size_t next = dyll->ll[idx].next;
+
+	dyll_free_data(dyll,idx);
+	dyll_unlink(dyll,idx);
+	dyll_free_entry(dyll,idx);
+
+	cursor->entry = next;
+	cursor->stamp = dyll->version;
+	return true;
+}
+
+
+
+
+
+
+
+
+
+//--------------------- Compaction --------------------------------
+
+bool dyll_compact(pDyLL_Arr_t d, bool release_unused) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+
+	size_t n = dyll->items_inuse;
+	size_t new_alloc = dyll->items_alloc;
+	if (release_unused) {new_alloc = (n > INIT_ITEMS) ? n : INIT_ITEMS;}
+
+	pDyLL_LL_t ll = (pDyLL_LL_t) mem_alloc(dyll->alloc, new_alloc * sizeof(DyLL_LL_t));
+	size_t* stack = (size_t*) mem_alloc(dyll->alloc, (n ? n : 1) * sizeof(size_t));
+	if (!(ll && stack)) {
+		mem_free(dyll->alloc, ll, new_alloc * sizeof(DyLL_LL_t));
+		mem_free(dyll->alloc, stack, (n ? n : 1) * sizeof(size_t));
+		return false;
+	}
+
+	//Copy the items over in list order
+	size_t i, k = 0;
+	for (i = dyll->start_item; i != LL_NULL; i = dyll->ll[i].next, ++k) {
+		ll[k] = dyll->ll[i];
+		ll[k].pre = k - 1;		//Wraps around to LL_NULL for the first item
+		ll[k].next = k + 1;
+		if ((ll[k].kind == DATA_HEAP) || (ll[k].kind == DATA_ADOPTED)) {dyll->heap[ll[k].heap_slot] = k;}
+	}
+	if (n > 0) {ll[n-1].next = LL_NULL;}
+
+	//Everything after the list is free
+	for (i = n; i < new_alloc; ++i) {
+		ll[i].next = i+1;
+	}
+
+	mem_free(dyll->alloc, dyll->ll, dyll->items_alloc * sizeof(DyLL_LL_t));
+	dyll->ll = ll;
+	dyll->items_alloc = new_alloc;
+	dyll->start_item = (n > 0) ? 0 : LL_NULL;
+	dyll->end_item = (n > 0) ? (n - 1) : LL_NULL;
+	dyll->next_item = n;
+	dyll->version+=1;
+
+	dyll->root = tree_build(dyll, NULL, n, stack);
+	mem_free(dyll->alloc, stack, (n ? n : 1) * sizeof(size_t));
+	return true;
+}
+
+
+
+
+
+
+
+
+
+//--------------------- Byte Streams --------------------------------
+
+//Remove everything before element off of entry, and the first skip bytes of that element
+//	(entry is LL_NULL to remove everything). Only fails if an unrolled list can't trim the element
+static bool dyll_consume(pDyLL_Arr_Obj_t dyll, size_t entry, size_t off, size_t skip) {
+
+	//Drop the whole list at once
+	if (entry == LL_NULL) {
+		dyll_release_data(dyll);
+		dyll_reset_entries(dyll);
+		return true;
+	}
+
+	if (!dyll->block_size) {
+		while (dyll->start_item != entry) {
+			size_t idx = dyll->start_item;
+			dyll_free_data(dyll,idx);
+			dyll_unlink(dyll,idx);
+			dyll_free_entry(dyll,idx);
+		}
+
+		//The rest of the buffer stays where it is
+		pDyLL_LL_t ll = dyll->ll + entry;
+		ll->data = ((char*) ll->data) + skip;
+		ll->head += skip;
+		ll->len -= skip;
+		dyll->bytes-=skip;
+		return true;
+	}
+
+	while (dyll->start_item != entry) {unrolled_free_block(dyll,dyll->start_item);}
+	while (off-- > 0) {unrolled_delete(dyll,0);}
+	if (skip == 0) {return true;}
+
+	//Elements move around inside of their block, so the rest of the first one is copied
+	size_t len;
+	const void* data = dyll_element(dyll,dyll->start_item,0,&len);
+	void* rest = mem_alloc(dyll->alloc, len - skip);
+	if (!rest) {return false;}
+
+	memcpy(rest, ((const char*) data) + skip, len - skip);
+	bool ok = unrolled_insert(dyll,0,rest,len - skip);
+	if (ok) {unrolled_delete(dyll,1);}
+	mem_free(dyll->alloc, rest, len - skip);
+	return ok;
+}
+
+
+//Make a new (empty) item with a buffer of at least len bytes, all of it room to append into
+//	The item isn't linked into the list yet
+static size_t dyll_new_chunk(pDyLL_Arr_Obj_t dyll, size_t len) {
+	size_t entry = dyll_next_entry(dyll);
+	if (entry == LL_NULL) {return LL_NULL;}
+
+	size_t cap = (len > STREAM_CHUNK) ? len : STREAM_CHUNK;
+	pDyLL_LL_t ll = dyll->ll + entry;
+	ll->data = mem_alloc(dyll->alloc, cap);
+	if (!(ll->data && heap_add(dyll, entry))) {
+		mem_free(dyll->alloc, ll->data, cap);
+		dyll_free_entry(dyll,entry);
+		return LL_NULL;
+	}
+
+	ll->len = 0;
+	ll->head = 0;
+	ll->room = cap;
+	ll->kind = DATA_HEAP;
+	return entry;
+}
+
+//Add bytes that were just written into the room at the end of an item
+static inline void dyll_grow_chunk(pDyLL_Arr_Obj_t dyll, size_t entry, size_t len) {
+	dyll->ll[entry].len += len;
+	dyll->ll[entry].room -= len;
+	dyll->bytes+=len;
+}
+
+
+bool dyll_append_bytes(pDyLL_Arr_t d, const void* data, size_t len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && (data || (len == 0)))) {return false;}
+	if (len == 0) {return true;}
+	if (dyll->block_size) {return unrolled_insert(dyll,dyll_count(dyll),data,len);}
+
+	//Fill up the room at the end of the last item, then put the rest in a new one
+	size_t tail = dyll->end_item;
+	size_t fill = (tail != LL_NULL) ? dyll->ll[tail].room : 0;
+	if (fill > len) {fill = len;}
+
+	size_t entry = LL_NULL;
+	if (len > fill) {
+		entry = dyll_new_chunk(dyll, len - fill);
+		if (entry == LL_NULL) {return false;}
+	}
+
+	if (fill > 0) {
+		memcpy(((char*) dyll->ll[tail].data) + dyll->ll[tail].len, data, fill);
+		dyll_grow_chunk(dyll, tail, fill);
+	}
+	if (entry != LL_NULL) {
+		memcpy(dyll->ll[entry].data, ((const char*) data) + fill, len - fill);
+		dyll_grow_chunk(dyll, entry, len - fill);
+		dyll_link(dyll,entry,dyll->end_item);
+	}
+	return true;
+}
+
+
+size_t dyll_peek_bytes(pDyLL_Arr_t d, void* buf, size_t len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && buf)) {return 0;}
+
+	size_t total = 0, entry, off = 0;
+	for (entry = dyll->start_item; (entry != LL_NULL) && (total < len); dyll_step(dyll,&entry,&off)) {
+		size_t n;
+		const void* data = dyll_element(dyll,entry,off,&n);
+		if (n > len - total) {n = len - total;}
+
+		memcpy(((char*) buf) + total, data, n);
+		total += n;
+	}
+	return total;
+}
+
+
+size_t dyll_drain_bytes(pDyLL_Arr_t d, size_t len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return 0;}
+
+	if (len >= dyll->bytes) {
+		len = dyll->bytes;
+		dyll_consume(dyll, LL_NULL, 0, 0);
+		return len;
+	}
+
+	//Skip over every element that goes completely
+	size_t entry = dyll->start_item, off = 0, left = len;
+	while (true) {
+		size_t n;
+		dyll_element(dyll,entry,off,&n);
+		if (left < n) {break;}
+
+		left -= n;
+		dyll_step(dyll,&entry,&off);
+	}
+
+	if (!dyll_consume(dyll, entry, off, left)) {return len - left;}
+	return len;
+}
+
+
+//Does the stream match delim, starting at byte i of the element off of entry?
+static bool dyll_match_bytes(pDyLL_Arr_Obj_t dyll, size_t entry, size_t off, size_t i, const char* delim, size_t delim_len) {
+	while (delim_len > 0) {
+		if (entry == LL_NULL) {return false;}
+
+		size_t len;
+		const char* data = dyll_element(dyll,entry,off,&len);
+		size_t n = len - i;
+		if (n > delim_len) {n = delim_len;}
+		if (memcmp(data + i, delim, n) != 0) {return false;}
+
+		delim += n;
+		delim_len -= n;
+		i = 0;
+		dyll_step(dyll,&entry,&off);
+	}
+	return true;
+}
+
+size_t dyll_find_bytes(pDyLL_Arr_t d, size_t start, const void* delim, size_t delim_len) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!(dyll && delim) || (delim_len == 0)) {return -1;}
+
+	//pos is where the current element starts in the stream
+	size_t entry, off = 0, pos = 0;
+	for (entry = dyll->start_item; entry != LL_NULL; dyll_step(dyll,&entry,&off)) {
+		size_t len;
+		const char* data = dyll_element(dyll,entry,off,&len);
+		size_t i = (start > pos) ? (start - pos) : 0;
+
+		//Only check the places where the first byte matches
+		while (i < len) {
+			const char* hit = memchr(data + i, *((const char*) delim), len - i);
+			if (!hit) {break;}
+
+			i = (size_t) (hit - data);
+			if (dyll_match_bytes(dyll, entry, off, i, delim, delim_len)) {return pos + i;}
+			++i;
+		}
+		pos += len;
+	}
+	return -1;
+}
+
+
+
+
+
+
+
+
+
+//--------------------- File Descriptors --------------------------------
+
+#ifdef DYLL_WRITEV
+
+//Most iovecs passed to a single writev call
+#if defined(IOV_MAX) && (IOV_MAX < 1024)
+#define IOV_BATCH IOV_MAX
+#else
+#define IOV_BATCH 1024
+#endif
+
+
+//Write every payload to fd with writev, without copying anything
+//	If consume is true, everything that was written is removed from the list
+static bool dyll_writev(pDyLL_Arr_Obj_t dyll, int fd, size_t* written, bool consume) {
+	struct iovec iov[IOV_BATCH];
+	size_t total = 0;
+	bool ok = true;
+
+	size_t entry = dyll->start_item;
+	size_t off = 0;					//Element inside of entry (for unrolled lists)
+	size_t skip = 0;				//Bytes of the element that were already written
+	while (entry != LL_NULL) {
+
+		//Fill up a batch, skipping empty payloads
+		int count = 0;
+		size_t i = entry, o = off, len;
+		for (; (i != LL_NULL) && (count < IOV_BATCH); dyll_step(dyll,&i,&o)) {
+			size_t done = ((i == entry) && (o == off)) ? skip : 0;
+			char* data = dyll_element(dyll,i,o,&len);
+			if (len == done) {continue;}
+
+			iov[count].iov_base = data + done;
+			iov[count].iov_len = len - done;
+			++count;
+		}
+		if (count == 0) {entry = LL_NULL; break;}
+
+		ssize_t res = writev(fd, iov, count);
+		if (res < 0) {
+			if (errno == EINTR) {continue;}
+			ok = false;
+			break;
+		}
+		if (res == 0) {ok = false; break;}	//Nothing more can be written
+
+		//Walk forward past everything that was written (which might end in the middle of an element)
+		size_t left = (size_t) res;
+		total += left;
+		while (entry != LL_NULL) {
+			dyll_element(dyll,entry,off,&len);
+			if (left < len - skip) {break;}
+
+			left -= len - skip;
+			skip = 0;
+			dyll_step(dyll,&entry,&off);
+		}
+		skip += left;
+	}
+
+	if (consume && !dyll_consume(dyll, entry, off, skip)) {ok = false;}
+
+	if (written != NULL) {*written = total;}
+	return ok;
+}
+
+
+bool dyll_write_fd(pDyLL_Arr_t dyll, int fd, size_t* written) {
+	if (written != NULL) {*written = 0;}
+	if (!dyll) {return false;}
+	return dyll_writev((pDyLL_Arr_Obj_t) dyll, fd, written, false);
+}
+
+bool dyll_flush_fd(pDyLL_Arr_t dyll, int fd, size_t* written) {
+	if (written != NULL) {*written = 0;}
+	if (!dyll) {return false;}
+	return dyll_writev((pDyLL_Arr_Obj_t) dyll, fd, written, true);
+}
+
+
+
+bool dyll_read_fd(pDyLL_Arr_t d, int fd, size_t len, size_t* got) {
+	if (got != NULL) {*got = 0;}
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if (len == 0) {return true;}
+
+	ssize_t res;
+	if (dyll->block_size) {
+		//Unrolled lists copy everything into a block anyway
+		void* buf = mem_alloc(dyll->alloc, len);
+		if (!buf) {return false;}
+
+		do {res = read(fd, buf, len);} while ((res < 0) && (errno == EINTR));
+		bool ok = (res == 0) || ((res > 0) && unrolled_insert(dyll,dyll_count(dyll),buf,(size_t) res));
+		mem_free(dyll->alloc, buf, len);
+
+		if (ok && (got != NULL)) {*got = (size_t) res;}
+		return ok;
+	}
+
+	//Read into the room at the end of the last item, and a new item after it for anything that doesn't fit
+	struct iovec iov[2];
+	int count = 0;
+
+	size_t tail = dyll->end_item;
+	size_t fill = (tail != LL_NULL) ? dyll->ll[tail].room : 0;
+	if (fill > len) {fill = len;}
+	if (fill > 0) {
+		iov[count].iov_base = ((char*) dyll->ll[tail].data) + dyll->ll[tail].len;
+		iov[count].iov_len = fill;
+		++count;
+	}
+
+	size_t entry = LL_NULL;
+	if (len > fill) {
+		entry = dyll_new_chunk(dyll, len - fill);
+		if (entry == LL_NULL) {return false;}
+
+		iov[count].iov_base = dyll->ll[entry].data;
+		iov[count].iov_len = len - fill;
+		++count;
+	}
+
+	do {res = readv(fd, iov, count);} while ((res < 0) && (errno == EINTR));
+	size_t n = (res > 0) ? (size_t) res : 0;
+	size_t first = (n < fill) ? n : fill;
+
+	if (first > 0) {dyll_grow_chunk(dyll, tail, first);}
+	if (entry != LL_NULL) {
+		if (n > first) {
+			dyll_grow_chunk(dyll, entry, n - first);
+			dyll_link(dyll,entry,dyll->end_item);
+		} else {
+			dyll_free_data(dyll,entry);
+			dyll_free_entry(dyll,entry);
+		}
+	}
+
+	if (got != NULL) {*got = n;}
+	return (res >= 0);
+}
+
+#else
+
+//No writev on this platform
+bool dyll_write_fd(pDyLL_Arr_t dyll, int fd, size_t* written) {(void) dyll; (void) fd; if (written) {*written = 0;} return false;}
+bool dyll_flush_fd(pDyLL_Arr_t dyll, int fd, size_t* written) {(void) dyll; (void) fd; if (written) {*written = 0;} return false;}
+bool dyll_read_fd(pDyLL_Arr_t dyll, int fd, size_t len, size_t* got) {(void) dyll; (void) fd; (void) len; if (got) {*got = 0;} return false;}
+
+#endif // DYLL_WRITEV
+
+
+
+
+
+
+
+
+
+//--------------------- Splicing --------------------------------
+
+//Cut the items [first, first+count) out of the list, leaving them as a separate chain
+//	head and tail get the ends of the chain, and the return value is the root of its tree
+static size_t dyll_cut_run(pDyLL_Arr_Obj_t dyll, size_t first, size_t count, size_t* head, size_t* tail) {
+	pDyLL_LL_t ll = dyll->ll;
+	*head = dyll_get_index(dyll, first);
+	*tail = dyll_get_index(dyll, first + count - 1);
+
+	size_t a, b, c;
+	tree_split(dyll, dyll->root, first, &a, &b);
+	tree_split(dyll, b, count, &b, &c);
+	dyll->root = tree_merge(dyll, a, c);
+
+	size_t before = ll[*head].pre;
+	size_t after = ll[*tail].next;
+	if (before != LL_NULL) {ll[before].next = after;}
+	else {dyll->start_item = after;}
+	if (after != LL_NULL) {ll[after].pre = before;}
+	else {dyll->end_item = before;}
+
+	ll[*head].pre = LL_NULL;
+	ll[*tail].next = LL_NULL;
+	dyll->version+=1;
+	return b;
+}
+
+//Put a chain (and its tree) back into the list, so it starts at index
+static void dyll_paste_run(pDyLL_Arr_Obj_t dyll, size_t index, size_t head, size_t tail, size_t run_root) {
+	pDyLL_LL_t ll = dyll->ll;
+	size_t next = dyll_get_index(dyll, index);
+	size_t after = (next == LL_NULL) ? dyll->end_item : ll[next].pre;
+
+	ll[head].pre = after;
+	ll[tail].next = next;
+	if (after != LL_NULL) {ll[after].next = head;}
+	else {dyll->start_item = head;}
+	if (next != LL_NULL) {ll[next].pre = tail;}
+	else {dyll->end_item = tail;}
+
+	size_t a, c;
+	tree_split(dyll, dyll->root, index, &a, &c);
+	dyll->root = tree_merge(dyll, tree_merge(dyll, a, run_root), c);
+	dyll->version+=1;
+}
+
+
+//Can a payload be handed from src to dst as-is? (Slab payloads always need a copy)
+static bool dyll_can_migrate(pDyLL_Arr_Obj_t dst, pDyLL_Arr_Obj_t src, uint8_t kind) {
+	if (kind == DATA_HEAP) {return (dst->alloc == src->alloc);}
+	if (kind == DATA_ADOPTED) {
+		return (dst->free_func == src->free_func) && (src->free_func || (dst->alloc == src->alloc));
+	}
+	return false;
+}
+
+//Move [first, first+count) from src to index in another array
+//	All of the new entries are set up before src is touched, so a failure leaves both arrays alone
+static bool dyll_move_run(pDyLL_Arr_Obj_t dst, size_t index, pDyLL_Arr_Obj_t src, size_t first, size_t count) {
+	size_t* order = (size_t*) mem_alloc(dst->alloc, 2 * count * sizeof(size_t));
+	if (!order) {return false;}
+	size_t* stack = order + count;
+
+	//Make sure every payload that leaves the slab can be listed without failing
+	if (!heap_reserve(dst, count)) {
+		mem_free(dst->alloc, order, 2 * count * sizeof(size_t));
+		return false;
+	}
+
+	size_t i, k;
+	size_t s = dyll_get_index(src, first);
+	for (k = 0; k < count; ++k, s = src->ll[s].next) {
+		size_t d = dyll_next_entry(dst);
+		if (d == LL_NULL) {break;}
+
+		pDyLL_LL_t from = src->ll + s;
+		if (dyll_can_migrate(dst, src, from->kind)) {
+			dst->ll[d].data = from->data;
+			dst->ll[d].len = from->len;
+			dst->ll[d].head = from->head;
+			dst->ll[d].room = from->room;
+			dst->ll[d].kind = from->kind;
+			dst->bytes+=from->len;
+			heap_add(dst, d);
+		} else if (!dyll_copy_data(dst, d, from->data, from->len)) {
+			dyll_free_entry(dst, d);
+			break;
+		}
+		order[k] = d;
+	}
+
+	//Undo everything if something could not be allocated
+	if (k < count) {
+		s = dyll_get_index(src, first);
+		for (i = 0; i < k; ++i, s = src->ll[s].next) {
+			size_t d = order[i];
+			if (dyll_can_migrate(dst, src, src->ll[s].kind)) {
+				heap_remove(dst, d);
+				dst->bytes-=dst->ll[d].len;
+			} else {
+				dyll_free_data(dst, d);
+			}
+			dyll_free_entry(dst, d);
+		}
+		mem_free(dst->alloc, order, 2 * count * sizeof(size_t));
+		return false;
+	}
+
+	//Release the old entries (but not the payloads that moved over)
+	size_t head, tail;
+	dyll_cut_run(src, first, count, &head, &tail);
+	for (s = head; s != LL_NULL; ) {
+		size_t next = src->ll[s].next;
+		if (dyll_can_migrate(dst, src, src->ll[s].kind)) {
+			heap_remove(src, s);
+			src->bytes-=src->ll[s].len;
+		} else {
+			dyll_free_data(src, s);
+		}
+		dyll_free_entry(src, s);
+		s = next;
+	}
+
+	//Chain the new entries together, and give them a tree of their own before pasting them in
+	for (k = 0; k < count; ++k) {
+		pDyLL_LL_t ll = dst->ll + order[k];
+		ll->pre = (k > 0) ? order[k-1] : LL_NULL;
+		ll->next = (k + 1 < count) ? order[k+1] : LL_NULL;
+		ll->prio = tree_random(dst);
+	}
+	size_t run_root = tree_build(dst, order, count, stack);
+	dyll_paste_run(dst, index, order[0], order[count-1], run_root);
+
+	mem_free(dst->alloc, order, 2 * count * sizeof(size_t));
+	return true;
+}
+
+
+
+//Delete [first, first+count) from the list (which can't fail)
+static void dyll_erase_run(pDyLL_Arr_Obj_t dyll, size_t first, size_t count) {
+	size_t i;
+
+	//Dropping everything only has to free the pages
+	if (count == dyll_count(dyll)) {
+		dyll_release_data(dyll);
+		dyll_reset_entries(dyll);
+		return;
+	}
+
+	if (dyll->block_size) {
+		for (i = 0; i < count; ++i) {unrolled_delete(dyll, first);}
+		return;
+	}
+
+	size_t head, tail;
+	dyll_cut_run(dyll, first, count, &head, &tail);
+	for (i = head; i != LL_NULL; ) {
+		size_t next = dyll->ll[i].next;
+		dyll_free_data(dyll, i);
+		dyll_free_entry(dyll, i);
+		i = next;
+	}
+}
+
+//Add a copy of an element at index (which can be the count), in either kind of list
+static bool dyll_insert_copy(pDyLL_Arr_Obj_t dyll, size_t index, const void* element, size_t el_size) {
+	if (dyll->block_size) {return unrolled_insert(dyll, index, element, el_size);}
+
+	size_t next = dyll_next_entry(dyll);
+	if (next == LL_NULL) {return false;}
+
+	if (!dyll_copy_data(dyll, next, (void*) element, el_size)) {
+		dyll_free_entry(dyll, next);
+		return false;
+	}
+
+	size_t at = dyll_get_index(dyll, index);
+	dyll_link(dyll, next, (at == LL_NULL) ? dyll->end_item : dyll->ll[at].pre);
+	return true;
+}
+
+//Elements can't be handed to or from an unrolled list, so copy [first, first+count) of src to index in dst
+//	Nothing is removed from src. If a copy fails, the ones before it are taken back out of dst
+static bool dyll_copy_run(pDyLL_Arr_Obj_t dst, size_t index, pDyLL_Arr_Obj_t src, size_t first, size_t count) {
+	size_t k, off;
+	size_t entry = dyll_find(src, first, &off);
+	for (k = 0; k < count; ++k, dyll_step(src, &entry, &off)) {
+		size_t len;
+		const void* data = dyll_element(src, entry, off, &len);
+		if (!dyll_insert_copy(dst, index + k, data, len)) {
+			while (k-- > 0) {dyll_erase_run(dst, index, 1);}
+			return false;
+		}
+	}
+	return true;
+}
+
+//Splice to or from an unrolled list: copy everything over first, so that a failure leaves both lists alone
+static bool dyll_splice_copy(pDyLL_Arr_Obj_t dst, size_t index, pDyLL_Arr_Obj_t src, size_t first, size_t count) {
+	if (dst != src) {
+		if (!dyll_copy_run(dst, index, src, first, count)) {return false;}
+		dyll_erase_run(src, first, count);
+		return true;
+	}
+
+	//Copying inside of one list moves the elements around, so the run goes through a temporary list
+	pDyLL_Arr_Obj_t temp = dyll_create(src->alloc, src->block_size);
+	if (!temp) {return false;}
+	bool ok = dyll_copy_run(temp, 0, src, first, count) && dyll_copy_run(src, index, temp, 0, count);
+	free_dyll_array(temp);
+
+	if (ok) {dyll_erase_run(src, (index < first) ? (first + count) : first, count);}
+	return ok;
+}
+
+
+
+bool dyll_splice(pDyLL_Arr_t d, size_t index, pDyLL_Arr_t s, size_t first, size_t count) {
+
+	pDyLL_Arr_Obj_t dst = (pDyLL_Arr_Obj_t) d;
+	pDyLL_Arr_Obj_t src = (pDyLL_Arr_Obj_t) s;
+	if (!(dst && src)) {return false;}
+	if ((first > dyll_count(src)) || (count > dyll_count(src) - first)) {return false;}
+	if (index > dyll_count(dst)) {return false;}
+	if (count == 0) {return true;}
+
+	if (dst == src) {
+		if ((index > first) && (index < first + count)) {return false;}
+		if ((index == first) || (index == first + count)) {return true;}
+	}
+
+	if (dst->block_size || src->block_size) {return dyll_splice_copy(dst, index, src, first, count);}
+	if (dst != src) {return dyll_move_run(dst, index, src, first, count);}
+
+	//Within the same array, just relink
+
+	size_t head, tail;
+	size_t run_root = dyll_cut_run(dst, first, count, &head, &tail);
+	if (index > first) {index -= count;}
+	dyll_paste_run(dst, index, head, tail, run_root);
+	return true;
+}
+
+
+pDyLL_Arr_t dyll_split(pDyLL_Arr_t d, size_t index) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return NULL;}
+	if (index > dyll_count(dyll)) {return NULL;}
+
+	pDyLL_Arr_Obj_t tail = dyll_create(dyll->alloc, dyll->block_size);
+	if (!tail) {return NULL;}
+	tail->free_func = dyll->free_func;
+
+	if (!dyll_splice(tail, 0, dyll, index, dyll_count(dyll) - index)) {
+		free_dyll_array(tail);
+		return NULL;
+	}
+	return (pDyLL_Arr_t) tail;
+}
+
+
+bool dyll_concat(pDyLL_Arr_t d, pDyLL_Arr_t s) {
+
+	pDyLL_Arr_Obj_t dst = (pDyLL_Arr_Obj_t) d;
+	pDyLL_Arr_Obj_t src = (pDyLL_Arr_Obj_t) s;
+	if (!(dst && src) || (dst == src)) {return false;}
+	if (dyll_count(src) == 0) {return true;}
+
+	//Always move the shorter list: if dst is shorter, put it in front of src and then trade places
+	bool same = (dst->alloc == src->alloc) && (dst->free_func == src->free_func) && (dst->block_size == src->block_size);
+	if (same && (dyll_count(dst) < dyll_count(src))) {
+		if (!dyll_splice(src, 0, dst, 0, dyll_count(dst))) {return false;}
+
+		DyLL_Arr_Obj_t temp = *dst;
+		*dst = *src;
+		*src = temp;
+
+		//Cursors must not mistake one list for the other
+		size_t version = ((dst->version > src->version) ? dst->version : src->version) + 1;
+		dst->version = version;
+		src->version = version;
+		return true;
+	}
+
+	return dyll_splice(dst, dyll_count(dst), src, 0, dyll_count(src));
+}
+
+
+bool dyll_delete_range(pDyLL_Arr_t d, size_t first, size_t count) {
+
+	pDyLL_Arr_Obj_t dyll = (pDyLL_Arr_Obj_t) d;
+	if (!dyll) {return false;}
+	if ((first > dyll_count(dyll)) || (count > dyll_count(dyll) - first)) {return false;}
+	if (count == 0) {return true;}
+
+	dyll_erase_run(dyll, first, count);
+	return true;
 }
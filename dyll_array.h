@@ -10,12 +10,30 @@
 #include <stdbool.h>
 #include <stddef.h>		//For size_t
 #include <stdlib.h>		//For malloc and free
+#include "allocator.h"
 
 typedef void* pDyLL_Arr_t;
+typedef void (*DyLL_Free_Func_t)(void* buffer, size_t len);
 
 pDyLL_Arr_t new_dyll_array();
 void free_dyll_array(pDyLL_Arr_t dyll);
 
+//Same as above, but all memory comes from alloc (NULL uses malloc and free)
+//	Any buffer returned by a DyLL function must then be released with that allocator
+pDyLL_Arr_t new_dyll_array_alloc(pAllocator_t alloc);
+
+//Unrolled list: instead of one item per element, elements are packed into blocks of block_size bytes
+//	(0 picks a default of 512), which takes far less memory for small elements and is faster to walk.
+//	Blocks split when they fill up and merge when they empty out. Every function works the same way, except:
+//	 - Element pointers are only good until the list is changed, since elements move within their blocks
+//	 - Elements are only aligned to 8 bytes
+//	 - Adopted buffers are copied in and released right away
+//	 - Splicing to or from an unrolled list copies the elements instead of relinking them
+pDyLL_Arr_t new_unrolled_dyll_array(size_t block_size);
+pDyLL_Arr_t new_unrolled_dyll_array_alloc(size_t block_size, pAllocator_t alloc);
+
+//Every function that takes an index finds it in O(log n)
+
 //Add or remove elements from the array (makes a copy, or deletes the copy)
 bool dyll_add_element(pDyLL_Arr_t dyll, void* element, size_t el_size);
 bool dyll_delete_element(pDyLL_Arr_t dyll, size_t index);
@@ -26,6 +44,14 @@ bool dyll_add_element_before(pDyLL_Arr_t dyll, size_t index, void* element, size
 bool dyll_add_element_after(pDyLL_Arr_t dyll, size_t index, void* element, size_t el_size);
 
 
+//Same as above, but takes over a buffer instead of copying it (on failure, the caller still owns it)
+//	Adopted buffers are released with the free function below, or with the array's allocator if there isn't one
+bool dyll_adopt_element(pDyLL_Arr_t dyll, void* buffer, size_t el_size);
+bool dyll_adopt_element_before(pDyLL_Arr_t dyll, size_t index, void* buffer, size_t el_size);
+bool dyll_adopt_element_after(pDyLL_Arr_t dyll, size_t index, void* buffer, size_t el_size);
+void dyll_set_free_func(pDyLL_Arr_t dyll, DyLL_Free_Func_t func);
+
+
 
 //If len is NULL, then does not return the length of the element
 //	Whatever you do, do NOT free the returned pointer (it will mess up the internal array)
@@ -35,6 +61,8 @@ const void* dyll_get_element(pDyLL_Arr_t dyll, size_t index, size_t* len);
 void* dyll_copy_element(pDyLL_Arr_t dyll, size_t index, size_t* len);
 
 //Return the buffer at index, then delete the element from the array
+//	Small elements are stored inside of pages owned by the array, so these are copied into a new buffer
+//	Adopted elements are returned as they were given (so they go back to the free function, if one is set)
 void* dyll_flush_element(pDyLL_Arr_t dyll, size_t index, size_t* len);
 
 
@@ -46,6 +74,96 @@ void* dyll_flush_element(pDyLL_Arr_t dyll, size_t index, size_t* len);
 void* dyll_flush_array(pDyLL_Arr_t dyll, size_t* total_len);
 
 
+//Cursors walk the list one item at a time, and can add or delete items where they point
+//	without searching for an index (the position tree still takes O(log n) to update)
+//
+//	A cursor that moves off either end is no longer valid, but insert_before still works on a cursor
+//	that moved past the end (it adds to the end). It returns false for a cursor that moved off the front.
+//	Delete moves the cursor to the next item.
+//	In debug builds (without NDEBUG), a cursor stops working once the list is changed by anything else
+typedef struct {
+	pDyLL_Arr_t dyll;
+	size_t entry;		//Private: current item
+	size_t offset;		//Private: element inside of the item (unrolled lists)
+	size_t stamp;		//Private: list version the cursor expects
+} DyLL_Cursor_t, *pDyLL_Cursor_t;
+
+//Each of these returns false if the list is empty (or the index is out of range)
+bool dyll_cursor_begin(pDyLL_Arr_t dyll, pDyLL_Cursor_t cursor);
+bool dyll_cursor_end(pDyLL_Arr_t dyll, pDyLL_Cursor_t cursor);
+bool dyll_cursor_at(pDyLL_Arr_t dyll, size_t index, pDyLL_Cursor_t cursor);
+
+bool dyll_cursor_valid(pDyLL_Cursor_t cursor);
+bool dyll_cursor_next(pDyLL_Cursor_t cursor);	// Returns false after moving off the end
+bool dyll_cursor_prev(pDyLL_Cursor_t cursor);
+
+//Same rules as dyll_get_element()
+const void* dyll_cursor_get(pDyLL_Cursor_t cursor, size_t* len);
+size_t dyll_cursor_index(pDyLL_Cursor_t cursor);	// O(log n), or -1 on error
+
+//The cursor stays on the same item
+bool dyll_cursor_insert_before(pDyLL_Cursor_t cursor, void* element, size_t el_size);
+bool dyll_cursor_insert_after(pDyLL_Cursor_t cursor, void* element, size_t el_size);
+bool dyll_cursor_delete(pDyLL_Cursor_t cursor);
+
+
+
+//Move count elements starting at first in src, inserting them before the item at index in dst
+//	(index can be the count of dst, to add them to the end). dst can be the same as src, and then
+//	index is a position in the list before the move: an index strictly inside of the run fails,
+//	and first or first+count leaves the list alone. So on the list ABCD, moving A to index 3 gives BCAD
+//
+//	Within one array, this only relinks the items. Between arrays, payloads are handed over without
+//	copying, except for small ones stored inside of the array (or when the allocators don't match)
+bool dyll_splice(pDyLL_Arr_t dst, size_t index, pDyLL_Arr_t src, size_t first, size_t count);
+
+//Move everything from index onwards into a new array (which uses the same allocator)
+pDyLL_Arr_t dyll_split(pDyLL_Arr_t dyll, size_t index);
+
+//Move every element of src onto the end of dst, leaving src empty
+bool dyll_concat(pDyLL_Arr_t dst, pDyLL_Arr_t src);
+
+bool dyll_delete_range(pDyLL_Arr_t dyll, size_t first, size_t count);
+
+
+//Move every item so the internal array is in list order, which makes walking the list cache friendly
+//	If release_unused is true, also shrinks the internal array down to the number of items
+//	Invalidates any cursors
+bool dyll_compact(pDyLL_Arr_t dyll, bool release_unused);
+
+
+//Write every element to a file descriptor in order, straight from the array (with writev)
+//	written gets the number of bytes that went out, even if the write fails part of the way through
+//	(such as EAGAIN on a non-blocking socket)
+bool dyll_write_fd(pDyLL_Arr_t dyll, int fd, size_t* written);
+
+//Same as above, but removes everything that was written from the array
+//	If the write stops in the middle of an element, only the rest of that element is kept
+bool dyll_flush_fd(pDyLL_Arr_t dyll, int fd, size_t* written);
+
+
+//Byte streams: these treat the whole array as one run of bytes, no matter where each element starts and ends
+//	(such as data read from a socket, then taken out a few bytes at a time)
+
+//Add bytes to the end, filling up any room left in the last element before adding a new one
+bool dyll_append_bytes(pDyLL_Arr_t dyll, const void* data, size_t len);
+
+//Copy up to len bytes from the start into buf, without removing them. Returns the number copied
+size_t dyll_peek_bytes(pDyLL_Arr_t dyll, void* buf, size_t len);
+
+//Remove up to len bytes from the start. Elements that are used up are freed, and the first element left
+//	is trimmed where it is, without copying the rest of it. Returns the number removed
+size_t dyll_drain_bytes(pDyLL_Arr_t dyll, size_t len);
+
+//Find the first copy of delim (which can cross elements) at or after byte start
+//	Returns its offset from the start of the stream, or -1 if there isn't one
+size_t dyll_find_bytes(pDyLL_Arr_t dyll, size_t start, const void* delim, size_t delim_len);
+
+//Read up to len bytes from fd straight into the room left in the last element (and a new element, if it needs more)
+//	got is 0 at the end of the file. Returns false on a read error (check errno, such as EAGAIN)
+bool dyll_read_fd(pDyLL_Arr_t dyll, int fd, size_t len, size_t* got);
+
+
 //Get the total number of items in the array (or -1 on error)
 size_t dyll_get_count(pDyLL_Arr_t dyll);
 
@@ -3,13 +3,31 @@
 //
 //	dynamic_array.c - Implementation for the Dynamic Array data structure
 //
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		/* For mremap */
+#endif
+
 #include "dynamic_array.h"
+#include "dynamic_array_sort.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>	/* For SIZE_MAX */
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ARRAY_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 //arr should be a pDynamic_Obj_t object
 #define ResAddr(arr,index) ((void*) (((char*) (arr)->ptr) + ((index) * (arr)->el_size)))
 
+#define DEFAULT_GROW_FACTOR 2.0     //Capacity doubles on every realloc
+#define DEFAULT_GROW_MIN    16      //  but always grows by at least 16 elements
+
 
 // Private Dynamic Array object
 typedef struct {
@@ -18,19 +36,367 @@ typedef struct {
     size_t index;   // Where to insert the next character
     size_t len;     // Absolute string length (with null-terminator)
     size_t max;     // Biggest index used (DO NOT MESS WITH THIS!!!)
+
+    double grow_factor; // Multiply the capacity by this much when full
+    size_t grow_min;    // Smallest number of elements to add when growing
+
+    int storage;        // Where the buffer comes from (STORAGE_XXX)
+    pAllocator_t alloc; // Where all memory comes from (NULL for malloc/free)
+
+    //Extra data for each type of storage
+    union {
+        struct {
+            int fd;             // Backing file
+            void* map;          // Start of the mapping, including the file header
+            size_t map_size;    // Size of the mapping (and the file) in bytes
+        };                  // STORAGE_MAPPED
+
+        struct {
+            char** segs;        // Segment directory (ptr is the first segment)
+            size_t num_segs;    // Number of segments allocated
+        };                  // STORAGE_SEGMENTED
+
+        struct {
+            void* inline_buf;   // Element space inside of the object itself
+            size_t inline_len;  // Number of elements that fit in inline_buf
+            size_t obj_size;    // Bytes allocated for the object (0 if the caller owns it)
+        };                  // STORAGE_INLINE
+    };
 } Dynamic_Obj_t, *pDynamic_Obj_t;
 
+//Make sure init_dynamic_array() can always fit the object
+_Static_assert(sizeof(Dynamic_Obj_t) <= DYNAMIC_ARRAY_HEADER_SIZE, "DYNAMIC_ARRAY_HEADER_SIZE is too small");
+
+
+//Types of buffer storage
+#define STORAGE_HEAP        0   // malloc/realloc/free
+#define STORAGE_MAPPED      1   // mmap'd file, grown with ftruncate/mremap
+#define STORAGE_SEGMENTED   2   // Segments that double in size, elements never move
+#define STORAGE_INLINE      3   // Inline buffer inside the object, then spills to the heap
+
+//Segment k holds (16 << k) elements
+#define SEGMENT_FIRST_BITS  4
+#define SEGMENT_MAX         (sizeof(size_t) * 8 - SEGMENT_FIRST_BITS)
+
+static bool mapped_resize(pDynamic_Obj_t arr, size_t new_len);
+static void mapped_close(pDynamic_Obj_t arr);
+
+
+
+//--------------------- Storage Helpers --------------------------------
+//
+// Everything below goes through these helpers, since segmented arrays are not contiguous.
+// Heap and mapped arrays are always one single run of elements.
+
+static inline size_t segment_len(size_t seg) {
+    return ((size_t) 1 << SEGMENT_FIRST_BITS) << seg;
+}
+
+//Total number of elements in the first num_segs segments
+static inline size_t segment_capacity(size_t num_segs) {
+    return (((size_t) 1 << num_segs) - 1) << SEGMENT_FIRST_BITS;
+}
+
+//Which segment holds index, and where inside of it
+//  Adding 16 to the index turns every segment into a power-of-2 bucket
+static inline size_t segment_of(size_t index, size_t* offset) {
+    size_t biased = index + ((size_t) 1 << SEGMENT_FIRST_BITS);
+    size_t top = (sizeof(size_t) * 8 - 1) - (size_t) __builtin_clzll((unsigned long long) biased);
+    *offset = biased - ((size_t) 1 << top);
+    return top - SEGMENT_FIRST_BITS;
+}
+
+
+static inline void* array_addr(pDynamic_Obj_t arr, size_t index) {
+    if (arr->storage != STORAGE_SEGMENTED) {return ResAddr(arr,index);}
+
+    size_t offset;
+    size_t seg = segment_of(index, &offset);
+    return arr->segs[seg] + offset * arr->el_size;
+}
+
+//Pointer to the contiguous run of elements starting at index (stopping at end)
+//  run gets the number of elements in it
+static inline char* array_run(pDynamic_Obj_t arr, size_t index, size_t end, size_t* run) {
+    if (arr->storage != STORAGE_SEGMENTED) {
+        *run = end - index;
+        return (char*) ResAddr(arr,index);
+    }
+
+    size_t offset;
+    size_t seg = segment_of(index, &offset);
+    size_t avail = segment_len(seg) - offset;
+    *run = ((end - index) < avail) ? (end - index) : avail;
+    return arr->segs[seg] + offset * arr->el_size;
+}
+
+
+//Copy count elements into the array, starting at index
+static void array_write(pDynamic_Obj_t arr, size_t index, const void* src, size_t count) {
+    const char* from = (const char*) src;
+    size_t end = index + count;
+    while (index < end) {
+        size_t run;
+        char* to = array_run(arr, index, end, &run);
+        memcpy(to, from, run * arr->el_size);
+        from+=run * arr->el_size;
+        index+=run;
+    }
+}
+
+//Copy count elements out of the array, starting at index
+static void array_read(pDynamic_Obj_t arr, size_t index, void* dst, size_t count) {
+    char* to = (char*) dst;
+    size_t end = index + count;
+    while (index < end) {
+        size_t run;
+        const char* from = array_run(arr, index, end, &run);
+        memcpy(to, from, run * arr->el_size);
+        to+=run * arr->el_size;
+        index+=run;
+    }
+}
+
+//Move count elements from one index to another (like memmove, the ranges can overlap)
+static void array_move(pDynamic_Obj_t arr, size_t to, size_t from, size_t count) {
+    if ((to == from) || (count == 0)) {return;}
+
+    if (arr->storage != STORAGE_SEGMENTED) {
+        memmove(ResAddr(arr,to), ResAddr(arr,from), count * arr->el_size);
+        return;
+    }
+
+    //Copy in pieces that stay within one segment on both sides
+    //  Going forwards when moving down and backwards when moving up never overwrites the source
+    size_t done = 0;
+    while (done < count) {
+        size_t left = count - done, run_to, run_from;
+        if (to < from) {
+            char* dst = array_run(arr, to + done, to + count, &run_to);
+            char* src = array_run(arr, from + done, from + count, &run_from);
+            size_t run = (run_to < run_from) ? run_to : run_from;
+            memmove(dst, src, run * arr->el_size);
+            done+=run;
+        } else {
+            //Find the piece that ends at the last element not yet moved
+            size_t off_to, off_from;
+            segment_of(to + left - 1, &off_to);
+            segment_of(from + left - 1, &off_from);
+            size_t run = ((off_to < off_from) ? off_to : off_from) + 1;
+            if (run > left) {run = left;}
+            memmove(array_addr(arr, to + left - run), array_addr(arr, from + left - run), run * arr->el_size);
+            done+=run;
+        }
+    }
+}
+
+
+//Grow or shrink the segment directory to hold at least new_len elements
+//  Existing segments are never touched
+static bool segmented_resize(pDynamic_Obj_t arr, size_t new_len) {
+
+    while (segment_capacity(arr->num_segs) < new_len) {
+        if (arr->num_segs >= SEGMENT_MAX) {return false;}
+
+        size_t len = segment_len(arr->num_segs);
+        if (len > SIZE_MAX / arr->el_size) {return false; /* Overflow */}
+
+        char* seg = mem_alloc(arr->alloc, len * arr->el_size);
+        if (!seg) {return false;}
+        arr->segs[arr->num_segs++] = seg;
+    }
+
+    //Release segments that are no longer needed
+    while ((arr->num_segs > 0) && (segment_capacity(arr->num_segs - 1) >= new_len)) {
+        arr->num_segs-=1;
+        mem_free(arr->alloc, arr->segs[arr->num_segs], segment_len(arr->num_segs) * arr->el_size);
+        arr->segs[arr->num_segs] = NULL;
+    }
+
+    arr->ptr = (arr->num_segs > 0) ? arr->segs[0] : NULL;
+    arr->len = segment_capacity(arr->num_segs);
+    return true;
+}
+
+
+
+//Elements stay in the inline buffer as long as they fit, and only then move to the heap
+//  Shrinking far enough moves them back inline
+static bool inline_resize(pDynamic_Obj_t arr, size_t new_len) {
+    bool on_heap = (arr->ptr != arr->inline_buf);
+
+    if (new_len <= arr->inline_len) {
+        if (on_heap) {
+            size_t keep = (arr->max < new_len) ? arr->max : new_len;
+            memcpy(arr->inline_buf, arr->ptr, keep * arr->el_size);
+            mem_free(arr->alloc, arr->ptr, arr->len * arr->el_size);
+            arr->ptr = arr->inline_buf;
+        }
+        arr->len = arr->inline_len;
+        return true;
+    }
+
+    if (new_len > SIZE_MAX / arr->el_size) {return false; /* Overflow */}
+
+    void* new_ptr;
+    if (on_heap) {
+        new_ptr = mem_realloc(arr->alloc, arr->ptr, arr->len * arr->el_size, new_len * arr->el_size);
+        if (!new_ptr) {return false;}
+    } else {
+        new_ptr = mem_alloc(arr->alloc, new_len * arr->el_size);
+        if (!new_ptr) {return false;}
+        memcpy(new_ptr, arr->inline_buf, arr->max * arr->el_size);
+    }
+
+    arr->ptr = new_ptr;
+    arr->len = new_len;
+    return true;
+}
+
+
+//Resize the internal buffer to hold exactly new_len elements
+static bool array_realloc(pDynamic_Obj_t arr, size_t new_len) {
+
+    if (arr->storage == STORAGE_MAPPED) {return mapped_resize(arr, new_len);}
+    if (arr->storage == STORAGE_INLINE) {return inline_resize(arr, new_len);}
+    if (arr->storage == STORAGE_SEGMENTED) {
+        bool was_empty = (arr->ptr == NULL);
+        if (!segmented_resize(arr, new_len)) {return false;}
+        if (was_empty) {arr->index = 0; arr->max = 0;}
+        return true;
+    }
+
+    if (new_len == 0) {
+        mem_free(arr->alloc, arr->ptr, arr->len * arr->el_size);
+        arr->ptr = NULL;
+        arr->len = 0;
+        return true;
+    }
+
+    if (new_len > SIZE_MAX / arr->el_size) {return false; /* Overflow */}
+
+    void* new_ptr = mem_realloc(arr->alloc, arr->ptr, arr->len * arr->el_size, new_len * arr->el_size);
+    if (!new_ptr) {return false;}
+
+    if (arr->ptr == NULL) {
+        arr->index = 0;
+        arr->max = 0;
+    }
+
+    arr->ptr = new_ptr;
+    arr->len = new_len;
+    return true;
+}
+
+
+//Make sure the buffer can hold at least "needed" elements
+//  Capacity grows geometrically, so appends are amortized O(1)
+static bool array_grow(pDynamic_Obj_t arr, size_t needed) {
+    if (arr->ptr && (needed <= arr->len)) {return true;}
+
+    size_t new_len = arr->len + arr->grow_min;
+    if (new_len < arr->len) {new_len = SIZE_MAX; /* Overflow */}
+
+    double geo = (double) arr->len * arr->grow_factor;
+    if ((geo > (double) new_len) && (geo < (double) SIZE_MAX)) {new_len = (size_t) geo;}
+    if (needed > new_len) {new_len = needed;}
+
+    return array_realloc(arr, new_len);
+}
+
 
 pDynamic_Arr_t new_dynamic_array(size_t el_size) {
-    if (el_size == 0) {return NULL;}
-    pDynamic_Obj_t arr = malloc(sizeof(Dynamic_Obj_t));
+    return new_dynamic_array_alloc(el_size, NULL);
+}
 
-    if (!arr) {return NULL;}
+
+//Set up an empty heap-based array
+static void array_init(pDynamic_Obj_t arr, size_t el_size, pAllocator_t alloc) {
+    memset(arr, 0, sizeof(Dynamic_Obj_t));
 
     arr->el_size = el_size;
     arr->index = 0;
+    arr->len = 0;
+    arr->max = 0;
     arr->ptr = NULL;
 
+    arr->grow_factor = DEFAULT_GROW_FACTOR;
+    arr->grow_min = DEFAULT_GROW_MIN;
+
+    arr->storage = STORAGE_HEAP;
+    arr->alloc = alloc;
+}
+
+
+pDynamic_Arr_t new_dynamic_array_alloc(size_t el_size, pAllocator_t alloc) {
+    if (el_size == 0) {return NULL;}
+    pDynamic_Obj_t arr = mem_alloc(alloc, sizeof(Dynamic_Obj_t));
+
+    if (!arr) {return NULL;}
+
+    array_init(arr, el_size, alloc);
+    return (pDynamic_Arr_t) arr;
+}
+
+
+//Turn an object (followed by its inline buffer) into an inline array
+//  The inline buffer starts at DYNAMIC_ARRAY_HEADER_SIZE, so it has the same alignment as mem
+static pDynamic_Arr_t inline_init(void* mem, size_t mem_size, size_t el_size, pAllocator_t alloc, size_t obj_size) {
+    pDynamic_Obj_t arr = (pDynamic_Obj_t) mem;
+    array_init(arr, el_size, alloc);
+
+    arr->storage = STORAGE_INLINE;
+    arr->inline_buf = ((char*) mem) + DYNAMIC_ARRAY_HEADER_SIZE;
+    arr->inline_len = (mem_size - DYNAMIC_ARRAY_HEADER_SIZE) / el_size;
+    arr->obj_size = obj_size;
+
+    arr->ptr = arr->inline_buf;
+    arr->len = arr->inline_len;
+    return (pDynamic_Arr_t) arr;
+}
+
+
+pDynamic_Arr_t new_small_dynamic_array(size_t el_size, size_t inline_bytes) {
+    return new_small_dynamic_array_alloc(el_size, inline_bytes, NULL);
+}
+
+pDynamic_Arr_t new_small_dynamic_array_alloc(size_t el_size, size_t inline_bytes, pAllocator_t alloc) {
+    if (el_size == 0) {return NULL;}
+    if (inline_bytes > SIZE_MAX - DYNAMIC_ARRAY_HEADER_SIZE) {return NULL;}
+
+    //Header and inline buffer come from a single allocation
+    size_t obj_size = DYNAMIC_ARRAY_HEADER_SIZE + inline_bytes;
+    void* mem = mem_alloc(alloc, obj_size);
+    if (!mem) {return NULL;}
+
+    return inline_init(mem, obj_size, el_size, alloc, obj_size);
+}
+
+
+pDynamic_Arr_t init_dynamic_array(void* mem, size_t mem_size, size_t el_size) {
+    return init_dynamic_array_alloc(mem, mem_size, el_size, NULL);
+}
+
+pDynamic_Arr_t init_dynamic_array_alloc(void* mem, size_t mem_size, size_t el_size, pAllocator_t alloc) {
+    if (!mem || (el_size == 0) || (mem_size < DYNAMIC_ARRAY_HEADER_SIZE)) {return NULL;}
+    return inline_init(mem, mem_size, el_size, alloc, 0);
+}
+
+
+pDynamic_Arr_t new_segmented_dynamic_array(size_t el_size) {
+    return new_segmented_dynamic_array_alloc(el_size, NULL);
+}
+
+
+pDynamic_Arr_t new_segmented_dynamic_array_alloc(size_t el_size, pAllocator_t alloc) {
+    pDynamic_Obj_t arr = (pDynamic_Obj_t) new_dynamic_array_alloc(el_size, alloc);
+    if (!arr) {return NULL;}
+
+    arr->segs = mem_alloc(alloc, SEGMENT_MAX * sizeof(char*));
+    if (!arr->segs) {mem_free(alloc, arr, sizeof(Dynamic_Obj_t)); return NULL;}
+    memset(arr->segs, 0, SEGMENT_MAX * sizeof(char*));
+
+    arr->storage = STORAGE_SEGMENTED;
     return (pDynamic_Arr_t) arr;
 }
 
@@ -47,8 +413,19 @@ void free_dynamic_array(pDynamic_Arr_t a, Free_Func_t func) {
         }
     }
 
-    if (arr->ptr != NULL) {free(arr->ptr);}
-    free(arr);
+    if (arr->storage == STORAGE_INLINE) {
+        if (arr->ptr != arr->inline_buf) {mem_free(arr->alloc, arr->ptr, arr->len * arr->el_size);}
+        if (arr->obj_size > 0) {mem_free(arr->alloc, arr, arr->obj_size);}
+        return;
+    }
+
+    if (arr->storage == STORAGE_MAPPED) {mapped_close(arr);}
+    else if (arr->storage == STORAGE_SEGMENTED) {
+        segmented_resize(arr, 0);
+        mem_free(arr->alloc, arr->segs, SEGMENT_MAX * sizeof(char*));
+    }
+    else {mem_free(arr->alloc, arr->ptr, arr->len * arr->el_size);}
+    mem_free(arr->alloc, arr, sizeof(Dynamic_Obj_t));
 }
 
 
@@ -60,25 +437,10 @@ bool add_array_element(pDynamic_Arr_t a,const void* new) {
 	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
     if (!(arr && new)) {return false;}
 
-    if (arr->ptr == NULL) {
-        arr->index = 0;
-        arr->max = 0;
-        arr->len = 16;  //Initial length
-        arr->ptr = malloc(arr->len * arr->el_size);
-    }
-
-    if (!arr->ptr) {return false;}
-
-    if (arr->index >= arr->len) {
-		void* new_ptr = realloc(arr->ptr, (arr->len+16) * arr->el_size);
-		if (!new_ptr) {return false;}
-
-        arr->len+=16;
-        arr->ptr = new_ptr;
-    }
+    if (!array_grow(arr, arr->index + 1)) {return false;}
 
 
-    memcpy(ResAddr(arr,arr->index),new,arr->el_size);
+    memcpy(array_addr(arr,arr->index),new,arr->el_size);
 
     arr->index+=1;
     if (arr->index > arr->max) {arr->max = arr->index;}
@@ -90,25 +452,105 @@ bool add_array_elements(pDynamic_Arr_t a, const void* new_arr, size_t count) {
 
 	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
 	if (!(a && new_arr)) {return false;}
+    if (count == 0) {return true;}
 
-    size_t i;
-    for (i = 0; i < count; ++i) {
-		void* next = (void*) (((char*) new_arr) + (i * arr->el_size));
-		if (!add_array_element(arr,next)) {return false;}
-    }
+    //Grow once, then copy everything in one go
+    if (arr->index + count < arr->index) {return false; /* Overflow */}
+    if (!array_grow(arr, arr->index + count)) {return false;}
 
+    array_write(arr, arr->index, new_arr, count);
+
+    arr->index+=count;
+    if (arr->index > arr->max) {arr->max = arr->index;}
 	return true;
 }
 
 bool add_array_elements_p(pDynamic_Arr_t a, const void** new_ptrs, size_t count) {
 
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
     if (!(a && new_ptrs)) {return false;}
+    if (count == 0) {return true;}
+
+    if (arr->index + count < arr->index) {return false; /* Overflow */}
+    if (!array_grow(arr, arr->index + count)) {return false;}
 
     size_t i;
     for (i = 0; i < count; ++i) {
-        if (!add_array_element(a,new_ptrs[i])) {return false;}
+        if (!new_ptrs[i]) {break;}
+        memcpy(array_addr(arr,arr->index), new_ptrs[i], arr->el_size);
+        arr->index+=1;
+    }
+
+    if (arr->index > arr->max) {arr->max = arr->index;}
+	return (i == count);
+}
+
+
+bool insert_array_elements(pDynamic_Arr_t a, size_t index, const void* new_arr, size_t count) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+	if (!(arr && new_arr)) {return false;}
+    if (index > get_array_count(arr)) {return false;}
+    if (count == 0) {return true;}
+
+    if (arr->max + count < arr->max) {return false; /* Overflow */}
+    if (!array_grow(arr, arr->max + count)) {return false;}
+
+    //Open up a gap for the new elements
+    array_move(arr, index + count, index, arr->max - index);
+    array_write(arr, index, new_arr, count);
+
+    //Anything at or after the gap gets shifted up
+    arr->max+=count;
+    if (arr->index >= index) {arr->index+=count;}
+	return true;
+}
+
+
+bool erase_array_range(pDynamic_Arr_t a, size_t first, size_t last) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+	if (!arr) {return false;}
+    if ((first > last) || (last > get_array_count(arr))) {return false;}
+    if (first == last) {return true;}
+
+    //Close the gap left by the range
+    size_t count = last - first;
+    array_move(arr, first, last, arr->max - last);
+
+    arr->max-=count;
+    if (arr->index >= last) {arr->index-=count;}
+    else if (arr->index > first) {arr->index = first;}
+	return true;
+}
+
+
+//All elements from src are moved into dst, leaving src empty
+bool splice_dynamic_array(pDynamic_Arr_t d, size_t index, pDynamic_Arr_t s) {
+
+	pDynamic_Obj_t dst = (pDynamic_Obj_t) d;
+	pDynamic_Obj_t src = (pDynamic_Obj_t) s;
+	if (!(dst && src) || (dst == src)) {return false;}
+    if (dst->el_size != src->el_size) {return false;}
+
+    size_t count = get_array_count(src);
+    if (count == 0) {return (index <= get_array_count(dst));}
+
+    //Segmented arrays have to be gathered into one buffer first
+    if (src->storage == STORAGE_SEGMENTED) {
+        void* temp = malloc(count * src->el_size);
+        if (!temp) {return false;}
+
+        array_read(src, 0, temp, count);
+        bool ok = insert_array_elements(dst, index, temp, count);
+        free(temp);
+        if (!ok) {return false;}
+    } else {
+        if (!insert_array_elements(dst, index, src->ptr, count)) {return false;}
     }
 
+    src->index = 0;
+    src->max = 0;
 	return true;
 }
 
@@ -118,17 +560,19 @@ bool delete_array_element(pDynamic_Arr_t a, size_t index, bool maintainOrder) {
 
 	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
 	if (!arr) {return false;}
-	if (index >= arr->len) {return false;}
+	if (index >= get_array_count(arr)) {return false;}
 	
-	arr->max-=1;
 	if (maintainOrder) {
 		//Move all other elements back
-		memmove(ResAddr(arr,index), ResAddr(arr,index+1), index - arr->max);
+		return erase_array_range(arr, index, index+1);
+	}
 
-	} else {
-		//Move the last element into the space (does not overlap)
-		memcpy(ResAddr(arr,arr->max), ResAddr(arr,index), arr->el_size);
+	//Move the last element into the space (does not overlap)
+	arr->max-=1;
+	if (index != arr->max) {
+		memcpy(array_addr(arr,index), array_addr(arr,arr->max), arr->el_size);
 	}
+	if (arr->index > arr->max) {arr->index = arr->max;}
 
 	return true;
 }
@@ -150,7 +594,7 @@ void* get_array_element(pDynamic_Arr_t a, size_t index) {
     if (!arr) {return NULL;}
     if (index >= arr->len) {return NULL;}
 
-    return ResAddr(arr,index); 
+    return array_addr(arr,index);
 }
 
 //Return NULL on error or an empty array
@@ -159,11 +603,52 @@ void* flush_dynamic_array(pDynamic_Arr_t a) {
 	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
     if (!arr) {return NULL;}
 
+    //Mapped arrays hand back a copy, but keep the file
+    if (arr->storage == STORAGE_MAPPED) {
+        void* ret = NULL;
+        if (arr->max > 0) {
+            ret = mem_alloc(arr->alloc, arr->max * arr->el_size);
+            if (!ret) {return NULL;}
+            memcpy(ret, arr->ptr, arr->max * arr->el_size);
+        }
+        arr->index = 0;
+        arr->max = 0;
+        return ret;
+    }
+
+    //Inline arrays hand back a heap copy, and go back to using the inline buffer
+    if (arr->storage == STORAGE_INLINE) {
+        void* ret = NULL;
+        if (arr->max > 0) {
+            ret = mem_alloc(arr->alloc, arr->max * arr->el_size);
+            if (!ret) {return NULL;}
+            memcpy(ret, arr->ptr, arr->max * arr->el_size);
+        }
+        arr->max = 0;
+        arr->index = 0;
+        inline_resize(arr, 0);
+        return ret;
+    }
+
+    //Segmented arrays get gathered into a single buffer
+    if (arr->storage == STORAGE_SEGMENTED) {
+        void* ret = NULL;
+        if (arr->max > 0) {
+            ret = mem_alloc(arr->alloc, arr->max * arr->el_size);
+            if (!ret) {return NULL;}
+            array_read(arr, 0, ret, arr->max);
+        }
+        segmented_resize(arr, 0);
+        arr->index = 0;
+        arr->max = 0;
+        return ret;
+    }
+
     //Resize array to match the max size
     void* ret = NULL;
-    if (arr->max == 0) {if (arr->ptr) {free(arr->ptr);} ret = NULL;}
+    if (arr->max == 0) {mem_free(arr->alloc, arr->ptr, arr->len * arr->el_size); ret = NULL;}
     else {
-		ret = realloc(arr->ptr,arr->max * arr->el_size);
+		ret = mem_realloc(arr->alloc, arr->ptr, arr->len * arr->el_size, arr->max * arr->el_size);
 		if (!ret) {return NULL; /* Realloc Failure (not good!) */}
 	}
 
@@ -183,3 +668,1045 @@ size_t get_array_count(pDynamic_Arr_t a) {
     if (arr->ptr == NULL) {return 0;}
     return (arr->max);
 }
+
+size_t get_array_element_size(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return 0;}
+    return arr->el_size;
+}
+
+
+
+//Change how the array grows when it runs out of space
+//  factor must be at least 1.0 (1.0 means fixed-size steps of min_step)
+bool set_array_growth(pDynamic_Arr_t a, double factor, size_t min_step) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if (!(factor >= 1.0) || (min_step == 0)) {return false;}
+
+    arr->grow_factor = factor;
+    arr->grow_min = min_step;
+    return true;
+}
+
+
+bool reserve_array(pDynamic_Arr_t a, size_t count) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if (arr->ptr && (count <= arr->len)) {return true;}
+    if (count == 0) {return true;}
+
+    return array_realloc(arr, count);
+}
+
+
+bool shrink_array_to_fit(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if (arr->len == arr->max) {return true;}
+
+    //Keep the insert index inside of the buffer
+    if (!array_realloc(arr, arr->max)) {return false;}
+    if (arr->index > arr->max) {arr->index = arr->max;}
+    return true;
+}
+
+
+size_t get_array_capacity(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return 0;}
+    if (arr->ptr == NULL) {return 0;}
+    return arr->len;
+}
+
+
+//Raw access to the element buffer (may be NULL for an empty array)
+//  The pointer becomes invalid as soon as the array grows
+void* get_array_data(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return NULL;}
+    if (arr->storage == STORAGE_SEGMENTED) {return NULL; /* Not contiguous */}
+    return arr->ptr;
+}
+
+void* get_array_run(pDynamic_Arr_t a, size_t index, size_t* run) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    size_t n = get_array_count(arr);
+    if (index >= n) {*run = 0; return NULL;}
+    return array_run(arr, index, n, run);
+}
+
+pAllocator_t get_array_allocator(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return NULL;}
+    return arr->alloc;
+}
+
+
+bool set_array_count(pDynamic_Arr_t a, size_t count) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if ((count > 0) && !array_grow(arr, count)) {return false;}
+
+    arr->max = count;
+    arr->index = count;
+    return true;
+}
+
+
+
+
+//--------------------- Sorting and Searching --------------------------------
+
+static inline void swap_elements(void* x, void* y, size_t size) {
+    char* a = (char*) x;
+    char* b = (char*) y;
+    if (a == b) {return;}
+
+    while (size >= sizeof(uint64_t)) {
+        uint64_t temp;
+        memcpy(&temp, a, sizeof(uint64_t));
+        memcpy(a, b, sizeof(uint64_t));
+        memcpy(b, &temp, sizeof(uint64_t));
+        a+=sizeof(uint64_t); b+=sizeof(uint64_t); size-=sizeof(uint64_t);
+    }
+    while (size > 0) {
+        char temp = *a; *a++ = *b; *b++ = temp;
+        --size;
+    }
+}
+
+
+
+//Get the elements as one contiguous buffer
+//  Only segmented arrays need a copy, which array_unflatten() writes back and frees
+//  (Scratch buffers like this one never outlive the call, so they skip the array's allocator)
+static void* array_flatten(pDynamic_Obj_t arr, size_t n) {
+    if (arr->storage != STORAGE_SEGMENTED) {return arr->ptr;}
+
+    void* flat = malloc(n * arr->el_size);
+    if (flat) {array_read(arr, 0, flat, n);}
+    return flat;
+}
+
+static void array_unflatten(pDynamic_Obj_t arr, void* flat, size_t n, bool write_back) {
+    if ((arr->storage != STORAGE_SEGMENTED) || !flat) {return;}
+    if (write_back) {array_write(arr, 0, flat, n);}
+    free(flat);
+}
+
+
+static void sift_down(void* base, size_t root, size_t n, size_t size, Compare_Func_t cmp) {
+    while (1) {
+        size_t child = 2 * root + 1;
+        if (child >= n) {return;}
+
+        if ((child + 1 < n) && (cmp(ElAddr(base,child,size), ElAddr(base,child+1,size)) < 0)) {++child;}
+        if (cmp(ElAddr(base,root,size), ElAddr(base,child,size)) >= 0) {return;}
+
+        swap_elements(ElAddr(base,root,size), ElAddr(base,child,size), size);
+        root = child;
+    }
+}
+
+static void heap_sort(void* base, size_t n, size_t size, Compare_Func_t cmp) {
+    size_t i;
+    for (i = n / 2; i > 0; --i) {sift_down(base, i-1, n, size, cmp);}
+
+    for (i = n - 1; i > 0; --i) {
+        swap_elements(base, ElAddr(base,i,size), size);
+        sift_down(base, 0, i, size, cmp);
+    }
+}
+
+
+//Quicksort that falls back to heapsort once the recursion gets too deep
+//  Small ranges are skipped, since insertion sort finishes them off at the end
+static void introsort_loop(void* base, size_t n, size_t size, Compare_Func_t cmp, size_t depth) {
+
+    while (n > SORT_INSERTION_MAX) {
+        if (depth == 0) {heap_sort(base, n, size, cmp); return;}
+        --depth;
+
+        //Median-of-three pivot, moved to the front
+        void* lo = base;
+        void* mid = ElAddr(base,n/2,size);
+        void* hi = ElAddr(base,n-1,size);
+        if (cmp(mid, lo) < 0) {swap_elements(mid, lo, size);}
+        if (cmp(hi, mid) < 0) {
+            swap_elements(hi, mid, size);
+            if (cmp(mid, lo) < 0) {swap_elements(mid, lo, size);}
+        }
+        swap_elements(lo, mid, size);
+
+        //Hoare partition (stops on equal keys, so duplicates split evenly)
+        size_t i = 0, j = n;
+        while (1) {
+            do {++i;} while ((i < n) && (cmp(ElAddr(base,i,size), base) < 0));
+            do {--j;} while (cmp(ElAddr(base,j,size), base) > 0);
+            if (i >= j) {break;}
+            swap_elements(ElAddr(base,i,size), ElAddr(base,j,size), size);
+        }
+        swap_elements(base, ElAddr(base,j,size), size);
+
+        //Recurse into the smaller half, loop on the larger one
+        size_t left = j;
+        size_t right = n - j - 1;
+        if (left < right) {
+            introsort_loop(base, left, size, cmp, depth);
+            base = ElAddr(base,j+1,size);
+            n = right;
+        } else {
+            introsort_loop(ElAddr(base,j+1,size), right, size, cmp, depth);
+            n = left;
+        }
+    }
+}
+
+
+bool sort_dynamic_array(pDynamic_Arr_t a, Compare_Func_t cmp) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!(arr && cmp)) {return false;}
+
+    size_t n = get_array_count(arr);
+    if (n < 2) {return true;}
+
+    void* temp = malloc(arr->el_size);
+    void* base = array_flatten(arr, n);
+    if (!(temp && base)) {free(temp); array_unflatten(arr, base, n, false); return false;}
+
+    size_t depth = 0, i;
+    for (i = n; i > 1; i >>= 1) {depth+=2;}
+
+    introsort_loop(base, n, arr->el_size, cmp, depth);
+    insertion_sort(base, n, arr->el_size, cmp, temp);
+
+    array_unflatten(arr, base, n, true);
+    free(temp);
+    return true;
+}
+
+
+
+//Read a key as an unsigned integer
+//  Signed keys have the sign bit flipped, so they sort correctly as unsigned
+static inline uint64_t read_radix_key(const void* ptr, size_t key_size, bool is_signed) {
+    switch(key_size) {
+        case 1: {uint8_t k;  memcpy(&k, ptr, 1); return is_signed ? (uint8_t)  (k ^ 0x80u) : k;}
+        case 2: {uint16_t k; memcpy(&k, ptr, 2); return is_signed ? (uint16_t) (k ^ 0x8000u) : k;}
+        case 4: {uint32_t k; memcpy(&k, ptr, 4); return is_signed ? (k ^ 0x80000000u) : k;}
+        default: {uint64_t k; memcpy(&k, ptr, 8); return is_signed ? (k ^ 0x8000000000000000ull) : k;}
+    }
+}
+
+
+//Stable LSD radix sort, one byte of the key per pass
+//  Passes where every key has the same digit are skipped
+bool radix_sort_dynamic_array(pDynamic_Arr_t a, size_t key_offset, size_t key_size, bool is_signed) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if (!((key_size == 1) || (key_size == 2) || (key_size == 4) || (key_size == 8))) {return false;}
+    if (key_offset + key_size > arr->el_size) {return false;}
+
+    size_t n = get_array_count(arr);
+    size_t size = arr->el_size;
+    if (n < 2) {return true;}
+
+    size_t (*counts)[256] = calloc(key_size, sizeof(*counts));
+    void* temp = malloc(n * size);
+    void* base = array_flatten(arr, n);
+    if (!(counts && temp && base)) {
+        free(counts); free(temp);
+        array_unflatten(arr, base, n, false);
+        return false;
+    }
+
+    //Build every histogram in a single read of the array
+    size_t i, pass;
+    const char* key = ((const char*) base) + key_offset;
+    for (i = 0; i < n; ++i, key+=size) {
+        uint64_t k = read_radix_key(key, key_size, is_signed);
+        for (pass = 0; pass < key_size; ++pass) {
+            counts[pass][(k >> (pass * 8)) & 0xFF]+=1;
+        }
+    }
+
+    void* from = base;
+    void* to = temp;
+    for (pass = 0; pass < key_size; ++pass) {
+        size_t* count = counts[pass];
+        unsigned shift = (unsigned) pass * 8;
+
+        //Skip the pass if every key has the same digit
+        uint64_t first = read_radix_key(((char*) from) + key_offset, key_size, is_signed);
+        if (count[(first >> shift) & 0xFF] == n) {continue;}
+
+        //Turn the counts into starting offsets
+        size_t total = 0, digit;
+        for (digit = 0; digit < 256; ++digit) {
+            size_t c = count[digit];
+            count[digit] = total;
+            total+=c;
+        }
+
+        const char* src = (const char*) from;
+        for (i = 0; i < n; ++i, src+=size) {
+            uint64_t k = read_radix_key(src + key_offset, key_size, is_signed);
+            size_t dest = count[(k >> shift) & 0xFF]++;
+            copy_element(ElAddr(to,dest,size), src, size);
+        }
+
+        void* swap = from; from = to; to = swap;
+    }
+
+    //Make sure the sorted data ends up back in the array
+    if (from != base) {memcpy(base, from, n * size);}
+    array_unflatten(arr, base, n, true);
+
+    free(counts);
+    free(temp);
+    return true;
+}
+
+
+
+//First element where cmp(element, key) >= 0
+size_t array_lower_bound(pDynamic_Arr_t a, const void* key, Compare_Func_t cmp) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!(arr && key && cmp)) {return 0;}
+
+    size_t lo = 0, n = get_array_count(arr);
+    while (n > 0) {
+        size_t half = n / 2;
+        if (cmp(array_addr(arr,lo+half), key) < 0) {
+            lo+=half+1;
+            n-=half+1;
+        } else {
+            n = half;
+        }
+    }
+    return lo;
+}
+
+//First element where cmp(element, key) > 0
+size_t array_upper_bound(pDynamic_Arr_t a, const void* key, Compare_Func_t cmp) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!(arr && key && cmp)) {return 0;}
+
+    size_t lo = 0, n = get_array_count(arr);
+    while (n > 0) {
+        size_t half = n / 2;
+        if (cmp(array_addr(arr,lo+half), key) <= 0) {
+            lo+=half+1;
+            n-=half+1;
+        } else {
+            n = half;
+        }
+    }
+    return lo;
+}
+
+size_t array_equal_range(pDynamic_Arr_t arr, const void* key, Compare_Func_t cmp, size_t* last) {
+    size_t first = array_lower_bound(arr, key, cmp);
+    if (last != NULL) {*last = array_upper_bound(arr, key, cmp);}
+    return first;
+}
+
+
+
+
+//--------------------- Scanning --------------------------------
+//
+// Scans work on elements of 1, 2, 4 or 8 bytes, treated as integers in the native byte order.
+// On x86 they are vectorized with SSE2 and AVX2 (picked at runtime). Any other element size
+// falls back to scalar code (equality only).
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define ARRAY_SCAN_SIMD
+#include <immintrin.h>
+#endif
+
+#define IsScanSize(size) (((size) == 1) || ((size) == 2) || ((size) == 4) || ((size) == 8))
+
+
+//Make a new output element slot for a filter
+static inline bool filter_push(pDynamic_Obj_t out, const void* el) {
+    if ((out->max >= out->len) || !out->ptr) {
+        if (!array_grow(out, out->max + 1)) {return false;}
+    }
+    copy_element(array_addr(out,out->max), el, out->el_size);
+    out->max+=1;
+    return true;
+}
+
+
+//Scalar kernels (also used for the tail of each vector kernel)
+//  Every kernel returns n if nothing is found
+static size_t scan_find_scalar(const char* p, size_t i, size_t n, size_t size, const void* value) {
+    if (IsScanSize(size)) {
+        uint64_t key = read_radix_key(value, size, false);
+        for (; i < n; ++i) {
+            if (read_radix_key(p + i * size, size, false) == key) {return i;}
+        }
+    } else {
+        for (; i < n; ++i) {
+            if (memcmp(p + i * size, value, size) == 0) {return i;}
+        }
+    }
+    return n;
+}
+
+static size_t scan_count_scalar(const char* p, size_t i, size_t n, size_t size, const void* value) {
+    size_t total = 0;
+    if (IsScanSize(size)) {
+        uint64_t key = read_radix_key(value, size, false);
+        for (; i < n; ++i) {
+            total+=(read_radix_key(p + i * size, size, false) == key);
+        }
+    } else {
+        for (; i < n; ++i) {
+            total+=(memcmp(p + i * size, value, size) == 0);
+        }
+    }
+    return total;
+}
+
+//min and max are keys from read_radix_key(), so they compare as unsigned
+static void scan_minmax_scalar(const char* p, size_t i, size_t n, size_t size, bool is_signed, uint64_t* min, uint64_t* max) {
+    for (; i < n; ++i) {
+        uint64_t key = read_radix_key(p + i * size, size, is_signed);
+        if (key < *min) {*min = key;}
+        if (key > *max) {*max = key;}
+    }
+}
+
+static bool scan_filter_scalar(const char* p, size_t i, size_t n, size_t size, bool is_signed, uint64_t lo, uint64_t hi, pDynamic_Obj_t out) {
+    for (; i < n; ++i) {
+        uint64_t key = read_radix_key(p + i * size, size, is_signed);
+        if ((key >= lo) && (key <= hi) && !filter_push(out, p + i * size)) {return false;}
+    }
+    return true;
+}
+
+
+
+#ifdef ARRAY_SCAN_SIMD
+
+//The generic kernels below take the element size W as a parameter, then get inlined into
+//  a wrapper for each size so every switch(W) folds away
+#define SCAN_INLINE static inline __attribute__((always_inline))
+#define SCAN_AVX2   __attribute__((target("avx2")))
+
+
+//Build the mask of in-range lanes, then add each matching element to the output
+#define SCAN_FILTER_MASK(m, W, base, out) \
+    while (m) { \
+        unsigned bit = (unsigned) __builtin_ctz(m); \
+        if (!filter_push((out), (base) + bit)) {return false;} \
+        m &= ~(((1u << (W)) - 1u) << bit); \
+    }
+
+
+//************SSE2************
+
+SCAN_INLINE __m128i sse2_set1(const void* p, unsigned W) {
+    switch(W) {
+        case 1: {int8_t v;  memcpy(&v, p, 1); return _mm_set1_epi8(v);}
+        case 2: {int16_t v; memcpy(&v, p, 2); return _mm_set1_epi16(v);}
+        case 4: {int32_t v; memcpy(&v, p, 4); return _mm_set1_epi32(v);}
+        default: {int64_t v; memcpy(&v, p, 8); return _mm_set1_epi64x(v);}
+    }
+}
+
+SCAN_INLINE __m128i sse2_sign_bit(unsigned W) {
+    switch(W) {
+        case 1: return _mm_set1_epi8((char) 0x80);
+        case 2: return _mm_set1_epi16((short) 0x8000);
+        case 4: return _mm_set1_epi32((int) 0x80000000);
+        default: return _mm_set1_epi64x((long long) 0x8000000000000000ull);
+    }
+}
+
+SCAN_INLINE __m128i sse2_eq(__m128i a, __m128i b, unsigned W) {
+    switch(W) {
+        case 1: return _mm_cmpeq_epi8(a, b);
+        case 2: return _mm_cmpeq_epi16(a, b);
+        case 4: return _mm_cmpeq_epi32(a, b);
+        default: {
+            //No 64-bit compare in SSE2, so both 32-bit halves must match
+            __m128i eq = _mm_cmpeq_epi32(a, b);
+            return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2,3,0,1)));
+        }
+    }
+}
+
+//Signed compare (SSE2 has no 64-bit version, so W = 8 is never vectorized)
+SCAN_INLINE __m128i sse2_gt(__m128i a, __m128i b, unsigned W) {
+    switch(W) {
+        case 1: return _mm_cmpgt_epi8(a, b);
+        case 2: return _mm_cmpgt_epi16(a, b);
+        default: return _mm_cmpgt_epi32(a, b);
+    }
+}
+
+SCAN_INLINE __m128i sse2_load(const char* p) {
+    return _mm_loadu_si128((const __m128i*) p);
+}
+
+
+SCAN_INLINE size_t sse2_find(const char* p, size_t n, const void* value, unsigned W) {
+    __m128i v = sse2_set1(value, W);
+    size_t per = 16 / W, i;
+    for (i = 0; i + per <= n; i+=per) {
+        unsigned m = (unsigned) _mm_movemask_epi8(sse2_eq(sse2_load(p + i * W), v, W));
+        if (m) {return i + __builtin_ctz(m) / W;}
+    }
+    return scan_find_scalar(p, i, n, W, value);
+}
+
+SCAN_INLINE size_t sse2_count(const char* p, size_t n, const void* value, unsigned W) {
+    __m128i v = sse2_set1(value, W);
+    size_t per = 16 / W, i, bits = 0;
+    for (i = 0; i + per <= n; i+=per) {
+        bits+=__builtin_popcount((unsigned) _mm_movemask_epi8(sse2_eq(sse2_load(p + i * W), v, W)));
+    }
+    return (bits / W) + scan_count_scalar(p, i, n, W, value);
+}
+
+//Only called for W < 8
+SCAN_INLINE void sse2_minmax(const char* p, size_t n, bool is_signed, uint64_t* min, uint64_t* max, unsigned W) {
+    size_t per = 16 / W, i;
+    if (n < per) {scan_minmax_scalar(p, 0, n, W, is_signed, min, max); return;}
+
+    //Unsigned values get their sign bit flipped so the signed compare works
+    __m128i bias = is_signed ? _mm_setzero_si128() : sse2_sign_bit(W);
+    __m128i vmin = _mm_xor_si128(sse2_load(p), bias);
+    __m128i vmax = vmin;
+    for (i = per; i + per <= n; i+=per) {
+        __m128i x = _mm_xor_si128(sse2_load(p + i * W), bias);
+        __m128i lt = sse2_gt(vmin, x, W);
+        __m128i gt = sse2_gt(x, vmax, W);
+        vmin = _mm_or_si128(_mm_and_si128(lt, x), _mm_andnot_si128(lt, vmin));
+        vmax = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, vmax));
+    }
+
+    char lanes[32];
+    _mm_storeu_si128((__m128i*) lanes, _mm_xor_si128(vmin, bias));
+    _mm_storeu_si128((__m128i*) (lanes + 16), _mm_xor_si128(vmax, bias));
+    scan_minmax_scalar(lanes, 0, 32 / W, W, is_signed, min, max);
+    scan_minmax_scalar(p, i, n, W, is_signed, min, max);
+}
+
+//Only called for W < 8
+SCAN_INLINE bool sse2_filter(const char* p, size_t n, bool is_signed, const void* lo, const void* hi, pDynamic_Obj_t out, unsigned W) {
+    __m128i bias = is_signed ? _mm_setzero_si128() : sse2_sign_bit(W);
+    __m128i vlo = _mm_xor_si128(sse2_set1(lo, W), bias);
+    __m128i vhi = _mm_xor_si128(sse2_set1(hi, W), bias);
+    size_t per = 16 / W, i;
+    for (i = 0; i + per <= n; i+=per) {
+        __m128i x = _mm_xor_si128(sse2_load(p + i * W), bias);
+        __m128i outside = _mm_or_si128(sse2_gt(vlo, x, W), sse2_gt(x, vhi, W));
+        unsigned m = (~(unsigned) _mm_movemask_epi8(outside)) & 0xFFFFu;
+        SCAN_FILTER_MASK(m, W, p + i * W, out);
+    }
+    return scan_filter_scalar(p, i, n, W, is_signed, read_radix_key(lo, W, is_signed), read_radix_key(hi, W, is_signed), out);
+}
+
+
+
+//************AVX2************
+
+SCAN_INLINE SCAN_AVX2 __m256i avx2_set1(const void* p, unsigned W) {
+    switch(W) {
+        case 1: {int8_t v;  memcpy(&v, p, 1); return _mm256_set1_epi8(v);}
+        case 2: {int16_t v; memcpy(&v, p, 2); return _mm256_set1_epi16(v);}
+        case 4: {int32_t v; memcpy(&v, p, 4); return _mm256_set1_epi32(v);}
+        default: {int64_t v; memcpy(&v, p, 8); return _mm256_set1_epi64x(v);}
+    }
+}
+
+SCAN_INLINE SCAN_AVX2 __m256i avx2_sign_bit(unsigned W) {
+    switch(W) {
+        case 1: return _mm256_set1_epi8((char) 0x80);
+        case 2: return _mm256_set1_epi16((short) 0x8000);
+        case 4: return _mm256_set1_epi32((int) 0x80000000);
+        default: return _mm256_set1_epi64x((long long) 0x8000000000000000ull);
+    }
+}
+
+SCAN_INLINE SCAN_AVX2 __m256i avx2_eq(__m256i a, __m256i b, unsigned W) {
+    switch(W) {
+        case 1: return _mm256_cmpeq_epi8(a, b);
+        case 2: return _mm256_cmpeq_epi16(a, b);
+        case 4: return _mm256_cmpeq_epi32(a, b);
+        default: return _mm256_cmpeq_epi64(a, b);
+    }
+}
+
+SCAN_INLINE SCAN_AVX2 __m256i avx2_gt(__m256i a, __m256i b, unsigned W) {
+    switch(W) {
+        case 1: return _mm256_cmpgt_epi8(a, b);
+        case 2: return _mm256_cmpgt_epi16(a, b);
+        case 4: return _mm256_cmpgt_epi32(a, b);
+        default: return _mm256_cmpgt_epi64(a, b);
+    }
+}
+
+SCAN_INLINE SCAN_AVX2 __m256i avx2_load(const char* p) {
+    return _mm256_loadu_si256((const __m256i*) p);
+}
+
+
+SCAN_INLINE SCAN_AVX2 size_t avx2_find(const char* p, size_t n, const void* value, unsigned W) {
+    __m256i v = avx2_set1(value, W);
+    size_t per = 32 / W, i;
+    for (i = 0; i + per <= n; i+=per) {
+        unsigned m = (unsigned) _mm256_movemask_epi8(avx2_eq(avx2_load(p + i * W), v, W));
+        if (m) {return i + __builtin_ctz(m) / W;}
+    }
+    return scan_find_scalar(p, i, n, W, value);
+}
+
+SCAN_INLINE SCAN_AVX2 size_t avx2_count(const char* p, size_t n, const void* value, unsigned W) {
+    __m256i v = avx2_set1(value, W);
+    size_t per = 32 / W, i, bits = 0;
+    for (i = 0; i + per <= n; i+=per) {
+        bits+=__builtin_popcount((unsigned) _mm256_movemask_epi8(avx2_eq(avx2_load(p + i * W), v, W)));
+    }
+    return (bits / W) + scan_count_scalar(p, i, n, W, value);
+}
+
+SCAN_INLINE SCAN_AVX2 void avx2_minmax(const char* p, size_t n, bool is_signed, uint64_t* min, uint64_t* max, unsigned W) {
+    size_t per = 32 / W, i;
+    if (n < per) {scan_minmax_scalar(p, 0, n, W, is_signed, min, max); return;}
+
+    __m256i bias = is_signed ? _mm256_setzero_si256() : avx2_sign_bit(W);
+    __m256i vmin = _mm256_xor_si256(avx2_load(p), bias);
+    __m256i vmax = vmin;
+    for (i = per; i + per <= n; i+=per) {
+        __m256i x = _mm256_xor_si256(avx2_load(p + i * W), bias);
+        vmin = _mm256_blendv_epi8(vmin, x, avx2_gt(vmin, x, W));
+        vmax = _mm256_blendv_epi8(vmax, x, avx2_gt(x, vmax, W));
+    }
+
+    char lanes[64];
+    _mm256_storeu_si256((__m256i*) lanes, _mm256_xor_si256(vmin, bias));
+    _mm256_storeu_si256((__m256i*) (lanes + 32), _mm256_xor_si256(vmax, bias));
+    scan_minmax_scalar(lanes, 0, 64 / W, W, is_signed, min, max);
+    scan_minmax_scalar(p, i, n, W, is_signed, min, max);
+}
+
+SCAN_INLINE SCAN_AVX2 bool avx2_filter(const char* p, size_t n, bool is_signed, const void* lo, const void* hi, pDynamic_Obj_t out, unsigned W) {
+    __m256i bias = is_signed ? _mm256_setzero_si256() : avx2_sign_bit(W);
+    __m256i vlo = _mm256_xor_si256(avx2_set1(lo, W), bias);
+    __m256i vhi = _mm256_xor_si256(avx2_set1(hi, W), bias);
+    size_t per = 32 / W, i;
+    for (i = 0; i + per <= n; i+=per) {
+        __m256i x = _mm256_xor_si256(avx2_load(p + i * W), bias);
+        __m256i outside = _mm256_or_si256(avx2_gt(vlo, x, W), avx2_gt(x, vhi, W));
+        unsigned m = ~(unsigned) _mm256_movemask_epi8(outside);
+        SCAN_FILTER_MASK(m, W, p + i * W, out);
+    }
+    return scan_filter_scalar(p, i, n, W, is_signed, read_radix_key(lo, W, is_signed), read_radix_key(hi, W, is_signed), out);
+}
+
+
+
+//************Dispatch************
+
+//Specialize each generic kernel for every element size
+#define SCAN_SPECIALIZE(isa, attr) \
+static attr size_t isa##_find_dispatch(const char* p, size_t n, const void* value, size_t W) { \
+    switch(W) { \
+        case 1: return isa##_find(p, n, value, 1); \
+        case 2: return isa##_find(p, n, value, 2); \
+        case 4: return isa##_find(p, n, value, 4); \
+        default: return isa##_find(p, n, value, 8); \
+    } \
+} \
+static attr size_t isa##_count_dispatch(const char* p, size_t n, const void* value, size_t W) { \
+    switch(W) { \
+        case 1: return isa##_count(p, n, value, 1); \
+        case 2: return isa##_count(p, n, value, 2); \
+        case 4: return isa##_count(p, n, value, 4); \
+        default: return isa##_count(p, n, value, 8); \
+    } \
+}
+
+SCAN_SPECIALIZE(sse2, )
+SCAN_SPECIALIZE(avx2, SCAN_AVX2)
+
+static SCAN_AVX2 void avx2_minmax_dispatch(const char* p, size_t n, bool is_signed, uint64_t* min, uint64_t* max, size_t W) {
+    switch(W) {
+        case 1: avx2_minmax(p, n, is_signed, min, max, 1); break;
+        case 2: avx2_minmax(p, n, is_signed, min, max, 2); break;
+        case 4: avx2_minmax(p, n, is_signed, min, max, 4); break;
+        default: avx2_minmax(p, n, is_signed, min, max, 8); break;
+    }
+}
+
+static void sse2_minmax_dispatch(const char* p, size_t n, bool is_signed, uint64_t* min, uint64_t* max, size_t W) {
+    switch(W) {
+        case 1: sse2_minmax(p, n, is_signed, min, max, 1); break;
+        case 2: sse2_minmax(p, n, is_signed, min, max, 2); break;
+        case 4: sse2_minmax(p, n, is_signed, min, max, 4); break;
+        default: scan_minmax_scalar(p, 0, n, W, is_signed, min, max); break;
+    }
+}
+
+static SCAN_AVX2 bool avx2_filter_dispatch(const char* p, size_t n, bool is_signed, const void* lo, const void* hi, pDynamic_Obj_t out, size_t W) {
+    switch(W) {
+        case 1: return avx2_filter(p, n, is_signed, lo, hi, out, 1);
+        case 2: return avx2_filter(p, n, is_signed, lo, hi, out, 2);
+        case 4: return avx2_filter(p, n, is_signed, lo, hi, out, 4);
+        default: return avx2_filter(p, n, is_signed, lo, hi, out, 8);
+    }
+}
+
+static bool sse2_filter_dispatch(const char* p, size_t n, bool is_signed, const void* lo, const void* hi, pDynamic_Obj_t out, size_t W) {
+    switch(W) {
+        case 1: return sse2_filter(p, n, is_signed, lo, hi, out, 1);
+        case 2: return sse2_filter(p, n, is_signed, lo, hi, out, 2);
+        case 4: return sse2_filter(p, n, is_signed, lo, hi, out, 4);
+        default: return scan_filter_scalar(p, 0, n, W, is_signed, read_radix_key(lo, W, is_signed), read_radix_key(hi, W, is_signed), out);
+    }
+}
+
+
+//Checked once, then cached
+//  Scans can run on several threads at once (parallel operations), so the cache is atomic.
+//  Two threads checking at the same time just store the same answer
+static bool scan_has_avx2(void) {
+    static atomic_int has_avx2 = -1;
+    int cached = atomic_load_explicit(&has_avx2, memory_order_relaxed);
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+        atomic_store_explicit(&has_avx2, cached, memory_order_relaxed);
+    }
+    return (cached == 1);
+}
+
+#endif // ARRAY_SCAN_SIMD
+
+
+
+//Run a scan on one contiguous run of elements, using the best kernel available
+static size_t scan_find_run(const char* p, size_t n, size_t W, const void* value) {
+#ifdef ARRAY_SCAN_SIMD
+    if (IsScanSize(W)) {
+        return scan_has_avx2() ? avx2_find_dispatch(p, n, value, W) : sse2_find_dispatch(p, n, value, W);
+    }
+#endif
+    return scan_find_scalar(p, 0, n, W, value);
+}
+
+static size_t scan_count_run(const char* p, size_t n, size_t W, const void* value) {
+#ifdef ARRAY_SCAN_SIMD
+    if (IsScanSize(W)) {
+        return scan_has_avx2() ? avx2_count_dispatch(p, n, value, W) : sse2_count_dispatch(p, n, value, W);
+    }
+#endif
+    return scan_count_scalar(p, 0, n, W, value);
+}
+
+//Only for W = 1, 2, 4 or 8
+static void scan_minmax_run(const char* p, size_t n, size_t W, bool is_signed, uint64_t* min, uint64_t* max) {
+#ifdef ARRAY_SCAN_SIMD
+    if (scan_has_avx2()) {avx2_minmax_dispatch(p, n, is_signed, min, max, W);}
+    else {sse2_minmax_dispatch(p, n, is_signed, min, max, W);}
+#else
+    scan_minmax_scalar(p, 0, n, W, is_signed, min, max);
+#endif
+}
+
+static bool scan_filter_run(const char* p, size_t n, size_t W, bool is_signed, const void* lo, const void* hi, pDynamic_Obj_t out) {
+#ifdef ARRAY_SCAN_SIMD
+    return scan_has_avx2() ? avx2_filter_dispatch(p, n, is_signed, lo, hi, out, W)
+                           : sse2_filter_dispatch(p, n, is_signed, lo, hi, out, W);
+#else
+    return scan_filter_scalar(p, 0, n, W, is_signed, read_radix_key(lo, W, is_signed), read_radix_key(hi, W, is_signed), out);
+#endif
+}
+
+
+
+size_t array_find_first(pDynamic_Arr_t a, const void* value, size_t start) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!(arr && value)) {return ARRAY_NOT_FOUND;}
+
+    size_t n = get_array_count(arr);
+    while (start < n) {
+        size_t run;
+        const char* p = array_run(arr, start, n, &run);
+        size_t found = scan_find_run(p, run, arr->el_size, value);
+        if (found < run) {return start + found;}
+        start+=run;
+    }
+    return ARRAY_NOT_FOUND;
+}
+
+
+size_t array_count_equal(pDynamic_Arr_t a, const void* value) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!(arr && value)) {return 0;}
+
+    size_t n = get_array_count(arr);
+    size_t i = 0, total = 0;
+    while (i < n) {
+        size_t run;
+        const char* p = array_run(arr, i, n, &run);
+        total+=scan_count_run(p, run, arr->el_size, value);
+        i+=run;
+    }
+    return total;
+}
+
+
+//Convert a key from read_radix_key() back into an element
+static inline void write_radix_key(void* ptr, uint64_t key, size_t key_size, bool is_signed) {
+    if (is_signed) {key ^= ((uint64_t) 1) << (key_size * 8 - 1);}
+    switch(key_size) {
+        case 1: {uint8_t k = (uint8_t) key;   memcpy(ptr, &k, 1); break;}
+        case 2: {uint16_t k = (uint16_t) key; memcpy(ptr, &k, 2); break;}
+        case 4: {uint32_t k = (uint32_t) key; memcpy(ptr, &k, 4); break;}
+        default: memcpy(ptr, &key, 8); break;
+    }
+}
+
+
+bool array_min_max(pDynamic_Arr_t a, bool is_signed, void* min, void* max) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr || !IsScanSize(arr->el_size)) {return false;}
+
+    size_t n = get_array_count(arr);
+    if (n == 0) {return false;}
+
+    uint64_t kmin = UINT64_MAX, kmax = 0;
+    size_t i = 0;
+    while (i < n) {
+        size_t run;
+        const char* p = array_run(arr, i, n, &run);
+        scan_minmax_run(p, run, arr->el_size, is_signed, &kmin, &kmax);
+        i+=run;
+    }
+
+    if (min != NULL) {write_radix_key(min, kmin, arr->el_size, is_signed);}
+    if (max != NULL) {write_radix_key(max, kmax, arr->el_size, is_signed);}
+    return true;
+}
+
+
+pDynamic_Arr_t filter_dynamic_array(pDynamic_Arr_t a, const void* lo, const void* hi, bool is_signed) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr || !IsScanSize(arr->el_size)) {return NULL;}
+
+    //Missing bounds are open-ended
+    size_t W = arr->el_size;
+    char lo_buf[8], hi_buf[8];
+    if (lo == NULL) {write_radix_key(lo_buf, 0, W, is_signed); lo = lo_buf;}
+    if (hi == NULL) {write_radix_key(hi_buf, UINT64_MAX >> (64 - W * 8), W, is_signed); hi = hi_buf;}
+
+    pDynamic_Obj_t out = (pDynamic_Obj_t) new_dynamic_array_alloc(W, arr->alloc);
+    if (!out) {return NULL;}
+
+    size_t n = get_array_count(arr);
+    size_t i = 0;
+    bool ok = true;
+    while (ok && (i < n)) {
+        size_t run;
+        const char* p = array_run(arr, i, n, &run);
+        ok = scan_filter_run(p, run, W, is_signed, lo, hi, out);
+        i+=run;
+    }
+
+    if (!ok) {free_dynamic_array(out, NULL); return NULL;}
+    out->index = out->max;
+    return (pDynamic_Arr_t) out;
+}
+
+
+
+
+//--------------------- Memory-Mapped Arrays --------------------------------
+//
+// The file starts with a 64-byte header, followed directly by the elements. The file is always
+// sized to the current capacity, so reopening it maps the elements as-is with no parsing.
+
+#define MAPPED_MAGIC        "DYNARR01"
+#define MAPPED_HEADER_SIZE  64
+
+typedef struct {
+    char magic[8];          // MAPPED_MAGIC
+    uint64_t el_size;       // Size of each element
+    uint64_t count;         // Number of elements in use (updated on sync and free)
+} Mapped_Header_t;
+
+
+#ifdef ARRAY_MMAP
+
+//Write the element count into the file header
+static void mapped_update_header(pDynamic_Obj_t arr) {
+    ((Mapped_Header_t*) arr->map)->count = arr->max;
+}
+
+
+//Grow or shrink the backing file, then remap it
+static bool mapped_resize(pDynamic_Obj_t arr, size_t new_len) {
+
+    if (new_len > (SIZE_MAX - MAPPED_HEADER_SIZE) / arr->el_size) {return false; /* Overflow */}
+    size_t new_size = MAPPED_HEADER_SIZE + new_len * arr->el_size;
+    if ((off_t) new_size < 0) {return false;}
+
+    //Grow the file first, so the new pages are valid as soon as they are mapped
+    if ((new_size > arr->map_size) && (ftruncate(arr->fd, (off_t) new_size) != 0)) {return false;}
+
+#ifdef __linux__
+    void* new_map = mremap(arr->map, arr->map_size, new_size, MREMAP_MAYMOVE);
+    if (new_map == MAP_FAILED) {return false;}
+#else
+    void* new_map = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, arr->fd, 0);
+    if (new_map == MAP_FAILED) {return false;}
+    munmap(arr->map, arr->map_size);
+#endif
+
+    //Shrinking the file can only happen once the pages are gone
+    if (new_size < arr->map_size) {
+        if (ftruncate(arr->fd, (off_t) new_size) != 0) { /* File just stays bigger */ }
+    }
+
+    arr->map = new_map;
+    arr->map_size = new_size;
+    arr->ptr = ((char*) new_map) + MAPPED_HEADER_SIZE;
+    arr->len = new_len;
+    return true;
+}
+
+
+static void mapped_close(pDynamic_Obj_t arr) {
+    mapped_update_header(arr);
+
+    //Trim the file down to the elements actually used
+    size_t used = MAPPED_HEADER_SIZE + arr->max * arr->el_size;
+    munmap(arr->map, arr->map_size);
+    if (used < arr->map_size) {
+        if (ftruncate(arr->fd, (off_t) used) != 0) { /* File just stays bigger */ }
+    }
+    close(arr->fd);
+
+    arr->map = NULL;
+    arr->ptr = NULL;
+    arr->fd = -1;
+}
+
+
+//Map an open file into a new array object
+//  A brand new (empty) file gets a fresh header
+static pDynamic_Arr_t mapped_attach(int fd, size_t el_size, bool create) {
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {return NULL;}
+
+    size_t file_size = (size_t) st.st_size;
+    if (create) {
+        file_size = MAPPED_HEADER_SIZE;
+        if (ftruncate(fd, (off_t) file_size) != 0) {return NULL;}
+    }
+    if (file_size < MAPPED_HEADER_SIZE) {return NULL;}
+
+    void* map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {return NULL;}
+
+    Mapped_Header_t* header = (Mapped_Header_t*) map;
+    if (create) {
+        memset(map, 0, MAPPED_HEADER_SIZE);
+        memcpy(header->magic, MAPPED_MAGIC, sizeof(header->magic));
+        header->el_size = el_size;
+    } else {
+        //Make sure this is actually one of our files
+        size_t capacity = (file_size - MAPPED_HEADER_SIZE) / el_size;
+        if ((memcmp(header->magic, MAPPED_MAGIC, sizeof(header->magic)) != 0) ||
+            (header->el_size != el_size) || (header->count > capacity)) {
+            munmap(map, file_size);
+            return NULL;
+        }
+    }
+
+    pDynamic_Obj_t arr = (pDynamic_Obj_t) new_dynamic_array(el_size);
+    if (!arr) {munmap(map, file_size); return NULL;}
+
+    arr->storage = STORAGE_MAPPED;
+    arr->fd = fd;
+    arr->map = map;
+    arr->map_size = file_size;
+    arr->ptr = ((char*) map) + MAPPED_HEADER_SIZE;
+    arr->len = (file_size - MAPPED_HEADER_SIZE) / el_size;
+    arr->max = (size_t) header->count;
+    arr->index = arr->max;
+
+    return (pDynamic_Arr_t) arr;
+}
+
+
+pDynamic_Arr_t new_mapped_dynamic_array(const char* path, size_t el_size) {
+    if (!path || (el_size == 0)) {return NULL;}
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {return NULL;}
+
+    pDynamic_Arr_t arr = mapped_attach(fd, el_size, true);
+    if (!arr) {close(fd);}
+    return arr;
+}
+
+
+pDynamic_Arr_t open_mapped_dynamic_array(const char* path, size_t el_size) {
+    if (!path || (el_size == 0)) {return NULL;}
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {return NULL;}
+
+    pDynamic_Arr_t arr = mapped_attach(fd, el_size, false);
+    if (!arr) {close(fd);}
+    return arr;
+}
+
+
+bool sync_dynamic_array(pDynamic_Arr_t a) {
+
+	pDynamic_Obj_t arr = (pDynamic_Obj_t) a;
+    if (!arr) {return false;}
+    if (arr->storage != STORAGE_MAPPED) {return true;}
+
+    mapped_update_header(arr);
+    return (msync(arr->map, arr->map_size, MS_SYNC) == 0);
+}
+
+#else
+
+//No mmap on this platform
+static bool mapped_resize(pDynamic_Obj_t arr, size_t new_len) {(void) arr; (void) new_len; return false;}
+static void mapped_close(pDynamic_Obj_t arr) {(void) arr;}
+
+pDynamic_Arr_t new_mapped_dynamic_array(const char* path, size_t el_size) {(void) path; (void) el_size; return NULL;}
+pDynamic_Arr_t open_mapped_dynamic_array(const char* path, size_t el_size) {(void) path; (void) el_size; return NULL;}
+bool sync_dynamic_array(pDynamic_Arr_t arr) {return (arr != NULL);}
+
+#endif // ARRAY_MMAP
@@ -8,14 +8,64 @@
 
 #include <stddef.h>	/* For size_t */
 #include <stdbool.h>
+#include "allocator.h"
 
 typedef void *pDynamic_Arr_t;
 typedef void (*Free_Func_t)(void*);
+typedef int (*Compare_Func_t)(const void*, const void*);	/* Same as qsort */
 
 
 pDynamic_Arr_t new_dynamic_array(size_t el_size);
 void free_dynamic_array(pDynamic_Arr_t, Free_Func_t func);
 
+//Same as above, but all memory comes from alloc (NULL uses malloc and free)
+//  Buffers returned by flush_dynamic_array must be released with the same allocator
+pDynamic_Arr_t new_dynamic_array_alloc(size_t el_size, pAllocator_t alloc);
+
+
+//Small arrays: the first inline_bytes worth of elements are stored inside the array object
+//  Nothing else is allocated until the array outgrows that space
+pDynamic_Arr_t new_small_dynamic_array(size_t el_size, size_t inline_bytes);
+pDynamic_Arr_t new_small_dynamic_array_alloc(size_t el_size, size_t inline_bytes, pAllocator_t alloc);
+
+//Build a small array inside memory owned by the caller (on the stack, inside a struct, etc.)
+//  mem must be aligned for any type, and hold at least DYNAMIC_ARRAY_HEADER_SIZE bytes
+//  Anything past the header is used as the inline buffer
+//
+//  free_dynamic_array still has to be called, but it does not free mem itself
+//
+//  Example:
+//    DYNAMIC_ARRAY_STORAGE(storage, 8 * sizeof(int));
+//    pDynamic_Arr_t arr = init_dynamic_array(&storage, sizeof(storage), sizeof(int));
+#define DYNAMIC_ARRAY_HEADER_SIZE 128
+#define DYNAMIC_ARRAY_STORAGE(name, inline_bytes) \
+    union {max_align_t align; char bytes[DYNAMIC_ARRAY_HEADER_SIZE + (inline_bytes)];} name
+
+pDynamic_Arr_t init_dynamic_array(void* mem, size_t mem_size, size_t el_size);
+pDynamic_Arr_t init_dynamic_array_alloc(void* mem, size_t mem_size, size_t el_size, pAllocator_t alloc);
+
+
+//File-backed arrays: the element buffer is an mmap'd file instead of a malloc'd buffer
+//  new creates (or truncates) the file, while open maps a file written by a previous run
+//  as-is, without copying or parsing anything (el_size must match the file)
+//
+//  The element count is stored in the file by sync_dynamic_array and free_dynamic_array
+//  Returns NULL on failure, or on platforms without mmap
+pDynamic_Arr_t new_mapped_dynamic_array(const char* path, size_t el_size);
+pDynamic_Arr_t open_mapped_dynamic_array(const char* path, size_t el_size);
+
+//Flush a file-backed array to disk (does nothing for other arrays)
+bool sync_dynamic_array(pDynamic_Arr_t arr);
+
+
+//Segmented arrays: elements are stored in a directory of chunks that double in size
+//  Growing never moves or copies existing elements, so pointers from get_array_element stay
+//  valid until that element is deleted or shifted by an insert or erase (or the array is freed)
+//
+//  get_array_data returns NULL, since the elements are not contiguous
+pDynamic_Arr_t new_segmented_dynamic_array(size_t el_size);
+pDynamic_Arr_t new_segmented_dynamic_array_alloc(size_t el_size, pAllocator_t alloc);
+
 
 bool add_array_element(pDynamic_Arr_t arr, const void* new);
 bool delete_array_element(pDynamic_Arr_t arr, size_t index, bool maintainOrder);
@@ -25,14 +75,96 @@ bool delete_array_element(pDynamic_Arr_t arr, size_t index, bool maintainOrder);
 bool add_array_elements(pDynamic_Arr_t arr, const void* new_arr, size_t count);
 bool add_array_elements_p(pDynamic_Arr_t arr, const void** new_ptrs, size_t count);
 
+//Range operations (each one grows the buffer at most once, and moves the tail at most once)
+//  Insert count elements before index (index == count appends to the end)
+bool insert_array_elements(pDynamic_Arr_t arr, size_t index, const void* new_arr, size_t count);
+
+//  Remove all elements in the range [first, last)
+bool erase_array_range(pDynamic_Arr_t arr, size_t first, size_t last);
+
+//  Move every element from src into dst before index, leaving src empty
+//    Both arrays must have the same element size
+bool splice_dynamic_array(pDynamic_Arr_t dst, size_t index, pDynamic_Arr_t src);
+
 //Where to insert the next value
 bool set_array_index(pDynamic_Arr_t arr, size_t index);
 
 void* get_array_element(pDynamic_Arr_t arr, size_t index);
 
 //Resize the pointer
+//  For file-backed arrays, this returns a malloc'd copy and empties the array
 void* flush_dynamic_array(pDynamic_Arr_t arr);
 
 size_t get_array_count(pDynamic_Arr_t arr);
+size_t get_array_element_size(pDynamic_Arr_t arr);
+
+
+//Capacity control
+//  When full, the capacity is multiplied by factor (at least 1.0) but grows by no less than
+//  min_step elements. The default is to double the capacity, with a minimum step of 16.
+bool set_array_growth(pDynamic_Arr_t arr, double factor, size_t min_step);
+
+//Make sure the array can hold at least count elements without reallocating
+bool reserve_array(pDynamic_Arr_t arr, size_t count);
+
+//Release any unused space at the end of the buffer
+bool shrink_array_to_fit(pDynamic_Arr_t arr);
+
+//Number of elements that fit in the buffer before it needs to grow again
+size_t get_array_capacity(pDynamic_Arr_t arr);
+
+
+//Raw access to the contiguous element buffer (NULL if nothing has been allocated)
+//  Any call that grows the array may move the buffer
+void* get_array_data(pDynamic_Arr_t arr);
+
+//Pointer to the contiguous run of elements starting at index, with its length stored in run
+//  Only segmented arrays are split into more than one run. Returns NULL past the end of the array
+void* get_array_run(pDynamic_Arr_t arr, size_t index, size_t* run);
+
+//Allocator the array was created with (NULL for malloc and free)
+pAllocator_t get_array_allocator(pDynamic_Arr_t arr);
+
+//Force the number of elements in the array (and move the insert index to the end)
+//  Grows the buffer if needed, but any new elements are left uninitialized
+bool set_array_count(pDynamic_Arr_t arr, size_t count);
+
+
+//Sorting (in place)
+//  sort uses introsort, so it is O(n log n) worst case but not stable
+bool sort_dynamic_array(pDynamic_Arr_t arr, Compare_Func_t cmp);
+
+//  Stable radix sort on an integer key stored inside each element
+//    key_size must be 1, 2, 4 or 8 bytes, and the key uses the native byte order
+bool radix_sort_dynamic_array(pDynamic_Arr_t arr, size_t key_offset, size_t key_size, bool is_signed);
+
+
+//Binary search on a sorted array
+//  The key is passed as the second argument to cmp, after the element
+//  Returns the count of the array if every element is less than the key
+size_t array_lower_bound(pDynamic_Arr_t arr, const void* key, Compare_Func_t cmp);	// First element >= key
+size_t array_upper_bound(pDynamic_Arr_t arr, const void* key, Compare_Func_t cmp);	// First element > key
+
+//Returns the first matching index, and stores one past the last match in last
+size_t array_equal_range(pDynamic_Arr_t arr, const void* key, Compare_Func_t cmp, size_t* last);
+
+
+//Linear scans over elements of 1, 2, 4 or 8 bytes, treated as integers in the native byte order
+//  These are vectorized with SSE2 or AVX2 (whichever the CPU supports) on x86 processors
+#define ARRAY_NOT_FOUND ((size_t) -1)
+
+//Find and count work on any element size (compared byte-for-byte)
+//  find returns ARRAY_NOT_FOUND if nothing at or after start matches
+size_t array_find_first(pDynamic_Arr_t arr, const void* value, size_t start);
+size_t array_count_equal(pDynamic_Arr_t arr, const void* value);
+
+//Copies the smallest and largest elements into min and max (either can be NULL)
+//  Returns false if the array is empty, or the element size is not supported
+bool array_min_max(pDynamic_Arr_t arr, bool is_signed, void* min, void* max);
+
+//Returns a new array with every element where lo <= element <= hi (order is kept)
+//  Use lo == hi to filter by value, or NULL to leave a bound open
+pDynamic_Arr_t filter_dynamic_array(pDynamic_Arr_t arr, const void* lo, const void* hi, bool is_signed);
+
 
 #endif // DYNAMIC_ARRAY_HEADER Included
@@ -0,0 +1,336 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	dynamic_array_parallel.c - Implementation for parallel operations on the Dynamic Array
+//
+//	  Every operation splits the array into chunks of grain elements and hands them to the pool.
+//	  The array must not be resized while one of these is running.
+//
+#include "dynamic_array_parallel.h"
+#include "dynamic_array_sort.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PARALLEL_MERGE_MIN  4096    //Smallest run size the parallel sort starts merging from
+
+
+
+//--------------------- Element Access --------------------------------
+
+//Get the elements as one contiguous buffer
+//  Only segmented arrays need a copy, which array_unflatten() writes back and frees
+static char* array_flatten(pDynamic_Arr_t arr, size_t n, size_t size) {
+    char* data = (char*) get_array_data(arr);
+    if (data) {return data;}
+
+    char* flat = malloc(n * size);
+    if (!flat) {return NULL;}
+
+    size_t i, run;
+    for (i = 0; i < n; i+=run) {
+        const char* p = (const char*) get_array_run(arr, i, &run);
+        memcpy(flat + i * size, p, run * size);
+    }
+    return flat;
+}
+
+static void array_unflatten(pDynamic_Arr_t arr, char* flat, size_t n, size_t size, bool write_back) {
+    if (!flat || (flat == get_array_data(arr))) {return;}
+
+    size_t i, run;
+    for (i = 0; write_back && (i < n); i+=run) {
+        char* p = (char*) get_array_run(arr, i, &run);
+        memcpy(p, flat + i * size, run * size);
+    }
+    free(flat);
+}
+
+
+//--------------------- Parallel Operations --------------------------------
+
+
+typedef struct {
+    pDynamic_Arr_t arr;
+    pDynamic_Arr_t out;         // Map output
+    size_t size;                // Element size of arr
+    Array_Each_Func_t each;
+    Array_Map_Func_t map;
+    Array_Combine_Func_t combine;
+    void* ctx;
+    const void* identity;
+    char* partials;             // One reduce result per chunk
+    size_t grain;
+} Parallel_Job_t, *pParallel_Job_t;
+
+
+//Contiguous run of elements starting at begin (stopping at end)
+static inline char* job_run(pParallel_Job_t job, size_t begin, size_t end, size_t* run) {
+    char* p = (char*) get_array_run(job->arr, begin, run);
+    if (*run > end - begin) {*run = end - begin;}
+    return p;
+}
+
+
+static void parallel_each_task(void* c, size_t begin, size_t end) {
+    pParallel_Job_t job = (pParallel_Job_t) c;
+    size_t size = job->size;
+
+    while (begin < end) {
+        size_t run, i;
+        char* p = job_run(job, begin, end, &run);
+        for (i = 0; i < run; ++i, p+=size) {job->each(p, job->ctx);}
+        begin+=run;
+    }
+}
+
+static void parallel_map_task(void* c, size_t begin, size_t end) {
+    pParallel_Job_t job = (pParallel_Job_t) c;
+    size_t size = job->size;
+    size_t out_size = get_array_element_size(job->out);
+    char* out = (char*) get_array_data(job->out) + begin * out_size;
+
+    while (begin < end) {
+        size_t run, i;
+        const char* p = job_run(job, begin, end, &run);
+        for (i = 0; i < run; ++i, p+=size, out+=out_size) {job->map(out, p, job->ctx);}
+        begin+=run;
+    }
+}
+
+//Each chunk folds into its own partial result, so no locking is needed
+static void parallel_reduce_task(void* c, size_t begin, size_t end) {
+    pParallel_Job_t job = (pParallel_Job_t) c;
+    size_t size = job->size;
+    void* acc = job->partials + (begin / job->grain) * size;
+    memcpy(acc, job->identity, size);
+
+    while (begin < end) {
+        size_t run, i;
+        const char* p = job_run(job, begin, end, &run);
+        for (i = 0; i < run; ++i, p+=size) {job->combine(acc, p, job->ctx);}
+        begin+=run;
+    }
+}
+
+
+bool parallel_for_each(pDynamic_Arr_t arr, Array_Each_Func_t func, void* ctx, pThread_Pool_t pool, size_t grain) {
+
+    if (!(arr && func)) {return false;}
+
+    Parallel_Job_t job = {0};
+    job.arr = arr;
+    job.size = get_array_element_size(arr);
+    job.each = func;
+    job.ctx = ctx;
+    return thread_pool_parallel_for(pool, get_array_count(arr), grain, parallel_each_task, &job);
+}
+
+
+pDynamic_Arr_t parallel_map(pDynamic_Arr_t arr, size_t out_size, Array_Map_Func_t func, void* ctx, pThread_Pool_t pool, size_t grain) {
+
+    if (!(arr && func)) {return NULL;}
+
+    //Output is always one contiguous heap array, sized up front
+    size_t n = get_array_count(arr);
+    pDynamic_Arr_t out = new_dynamic_array_alloc(out_size, get_array_allocator(arr));
+    if (!out) {return NULL;}
+    if (!(reserve_array(out, n) && set_array_count(out, n))) {
+        free_dynamic_array(out, NULL);
+        return NULL;
+    }
+
+    Parallel_Job_t job = {0};
+    job.arr = arr;
+    job.size = get_array_element_size(arr);
+    job.out = out;
+    job.map = func;
+    job.ctx = ctx;
+    thread_pool_parallel_for(pool, n, grain, parallel_map_task, &job);
+    return out;
+}
+
+
+bool parallel_reduce(pDynamic_Arr_t arr, void* result, const void* identity, Array_Combine_Func_t combine, void* ctx, pThread_Pool_t pool, size_t grain) {
+
+    if (!(arr && result && identity && combine)) {return false;}
+
+    size_t n = get_array_count(arr);
+    size_t size = get_array_element_size(arr);
+    if (grain == 0) {grain = thread_pool_auto_grain(pool, n);}
+
+    size_t chunks = (n / grain) + ((n % grain) ? 1 : 0);
+    Parallel_Job_t job = {0};
+    job.arr = arr;
+    job.size = size;
+    job.combine = combine;
+    job.ctx = ctx;
+    job.identity = identity;
+    job.grain = grain;
+    job.partials = malloc((chunks ? chunks : 1) * size);
+    if (!job.partials) {return false;}
+
+    thread_pool_parallel_for(pool, n, grain, parallel_reduce_task, &job);
+
+    //Combine the partial results in order, so combine only has to be associative
+    size_t i;
+    memcpy(result, identity, size);
+    for (i = 0; i < chunks; ++i) {combine(result, job.partials + i * size, ctx);}
+
+    free(job.partials);
+    return true;
+}
+
+
+
+typedef struct {
+    char* base;                 // Elements being sorted
+    char* temp;                 // Scratch buffer the same size
+    size_t n;
+    size_t size;
+    size_t width;               // Length of the sorted runs being merged
+    size_t parts;               // Number of pieces each merge is split into
+    Compare_Func_t cmp;
+    bool to_temp;               // Merge from base into temp (or the other way around)
+} Parallel_Sort_t, *pParallel_Sort_t;
+
+
+//Stable merge of two sorted runs, taking from the left run on ties
+static void merge_runs(char* to, const char* left, size_t nl, const char* right, size_t nr, size_t size, Compare_Func_t cmp) {
+    const char* left_end = left + nl * size;
+    const char* right_end = right + nr * size;
+
+    while ((left < left_end) && (right < right_end)) {
+        if (cmp(right, left) < 0) {memcpy(to, right, size); right+=size;}
+        else {memcpy(to, left, size); left+=size;}
+        to+=size;
+    }
+    if (left < left_end) {memcpy(to, left, (size_t) (left_end - left));}
+    if (right < right_end) {memcpy(to, right, (size_t) (right_end - right));}
+}
+
+//Bottom-up merge sort, starting from insertion-sorted runs
+//  Always leaves the result in base
+static void merge_sort(char* base, char* temp, size_t n, size_t size, Compare_Func_t cmp) {
+    size_t i, width;
+    for (i = 0; i < n; i+=SORT_INSERTION_MAX) {
+        size_t len = ((n - i) < SORT_INSERTION_MAX) ? (n - i) : SORT_INSERTION_MAX;
+        insertion_sort(ElAddr(base,i,size), len, size, cmp, temp);
+    }
+
+    char* from = base;
+    char* to = temp;
+    for (width = SORT_INSERTION_MAX; width < n; width*=2) {
+        for (i = 0; i < n; i+=2*width) {
+            size_t nl = ((n - i) < width) ? (n - i) : width;
+            size_t nr = ((n - i - nl) < width) ? (n - i - nl) : width;
+            merge_runs(to + i * size, from + i * size, nl, from + (i + nl) * size, nr, size, cmp);
+        }
+        char* swap = from; from = to; to = swap;
+    }
+    if (from != base) {memcpy(base, from, n * size);}
+}
+
+
+//Sort one run of width elements
+static void parallel_sort_task(void* c, size_t begin, size_t end) {
+    pParallel_Sort_t job = (pParallel_Sort_t) c;
+    size_t size = job->size;
+    for (; begin < end; ++begin) {
+        size_t first = begin * job->width;
+        size_t len = ((job->n - first) < job->width) ? (job->n - first) : job->width;
+        merge_sort(job->base + first * size, job->temp + first * size, len, size, job->cmp);
+    }
+}
+
+//How many of the first k merged elements come from the left run (the rest come from the right)
+//  Binary search for the split merge_runs() would make, so each piece can be merged on its own
+static size_t merge_split(size_t k, const char* left, size_t nl, const char* right, size_t nr, size_t size, Compare_Func_t cmp) {
+    size_t lo = (k > nr) ? (k - nr) : 0;
+    size_t hi = (k < nl) ? k : nl;
+
+    //Taking a from the left is too many if left[a-1] comes after right[k-a]
+    while (lo < hi) {
+        size_t a = lo + (hi - lo + 1) / 2;
+        if (cmp(right + (k - a) * size, left + (a - 1) * size) < 0) {hi = a - 1;}
+        else {lo = a;}
+    }
+    return lo;
+}
+
+//Merge one piece of a pair of runs
+//  Pieces split the output evenly, so even the last merge keeps every thread busy
+static void parallel_merge_task(void* c, size_t begin, size_t end) {
+    pParallel_Sort_t job = (pParallel_Sort_t) c;
+    size_t size = job->size, width = job->width, n = job->n;
+    const char* from = job->to_temp ? job->base : job->temp;
+    char* to = job->to_temp ? job->temp : job->base;
+
+    for (; begin < end; ++begin) {
+        size_t i = (begin / job->parts) * 2 * width;
+        size_t part = begin % job->parts;
+        size_t nl = ((n - i) < width) ? (n - i) : width;
+        size_t nr = ((n - i - nl) < width) ? (n - i - nl) : width;
+        const char* left = from + i * size;
+        const char* right = left + nl * size;
+
+        size_t first = ((nl + nr) / job->parts) * part;
+        size_t last = (part + 1 == job->parts) ? (nl + nr) : (first + (nl + nr) / job->parts);
+        size_t l0 = merge_split(first, left, nl, right, nr, size, job->cmp);
+        size_t l1 = merge_split(last, left, nl, right, nr, size, job->cmp);
+        merge_runs(to + (i + first) * size, left + l0 * size, l1 - l0,
+                   right + (first - l0) * size, (last - l1) - (first - l0), size, job->cmp);
+    }
+}
+
+
+//Stable parallel merge sort
+//  Every thread sorts its own runs, then pairs of runs are merged in parallel until one is left
+//  Once there are fewer pairs than threads, each merge is split into pieces as well
+bool parallel_sort(pDynamic_Arr_t arr, Compare_Func_t cmp, pThread_Pool_t pool, size_t grain) {
+
+    if (!(arr && cmp)) {return false;}
+
+    size_t n = get_array_count(arr);
+    size_t size = get_array_element_size(arr);
+    if (n < 2) {return true;}
+
+    //grain is the length of the runs each thread sorts on its own
+    if (grain == 0) {
+        grain = n / thread_pool_get_threads(pool);
+        if (grain < PARALLEL_MERGE_MIN) {grain = PARALLEL_MERGE_MIN;}
+    }
+
+    Parallel_Sort_t job;
+    job.temp = malloc(n * size);
+    job.base = array_flatten(arr, n, size);
+    if (!(job.temp && job.base)) {
+        free(job.temp);
+        array_unflatten(arr, job.base, n, size, false);
+        return false;
+    }
+    job.n = n;
+    job.size = size;
+    job.cmp = cmp;
+    job.width = grain;
+    job.to_temp = true;
+
+    size_t runs = (n / grain) + ((n % grain) ? 1 : 0);
+    thread_pool_parallel_for(pool, runs, 1, parallel_sort_task, &job);
+
+    //Each pass halves the number of runs, flipping between the two buffers
+    size_t threads = thread_pool_get_threads(pool);
+    while (job.width < n) {
+        size_t pairs = (n / (2 * job.width)) + ((n % (2 * job.width)) ? 1 : 0);
+        job.parts = (pairs < threads) ? ((threads + pairs - 1) / pairs) : 1;
+        thread_pool_parallel_for(pool, pairs * job.parts, 1, parallel_merge_task, &job);
+        job.to_temp = !job.to_temp;
+        job.width*=2;
+    }
+
+    //After an odd number of passes the result is in temp
+    if (!job.to_temp) {memcpy(job.base, job.temp, n * size);}
+    array_unflatten(arr, job.base, n, size, true);
+
+    free(job.temp);
+    return true;
+}
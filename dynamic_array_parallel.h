@@ -0,0 +1,34 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	dynamic_array_parallel.h - Header for parallel operations on the Dynamic Array
+//
+//	  Kept apart from dynamic_array.h, so only code that uses these has to build
+//	  thread_pool.c and link with -pthread
+//
+#ifndef DYNAMIC_ARRAY_PARALLEL_HEADER
+#define DYNAMIC_ARRAY_PARALLEL_HEADER
+
+#include "dynamic_array.h"
+#include "thread_pool.h"
+
+
+//Parallel operations, run on a thread pool (NULL runs everything on the calling thread)
+//  The array is split into chunks of grain elements (0 picks one automatically)
+typedef void (*Array_Each_Func_t)(void* element, void* ctx);
+typedef void (*Array_Map_Func_t)(void* out, const void* element, void* ctx);
+typedef void (*Array_Combine_Func_t)(void* acc, const void* element, void* ctx);	// acc = acc + element
+
+bool parallel_for_each(pDynamic_Arr_t arr, Array_Each_Func_t func, void* ctx, pThread_Pool_t pool, size_t grain);
+
+//Returns a new array of out_size elements, where out[i] = func(arr[i])
+pDynamic_Arr_t parallel_map(pDynamic_Arr_t arr, size_t out_size, Array_Map_Func_t func, void* ctx, pThread_Pool_t pool, size_t grain);
+
+//Folds every element into result, starting from identity (both are the size of one element)
+//  combine must be associative, but does not need to be commutative
+bool parallel_reduce(pDynamic_Arr_t arr, void* result, const void* identity, Array_Combine_Func_t combine, void* ctx, pThread_Pool_t pool, size_t grain);
+
+//Stable merge sort, where grain is the length of the runs each thread sorts on its own
+bool parallel_sort(pDynamic_Arr_t arr, Compare_Func_t cmp, pThread_Pool_t pool, size_t grain);
+
+#endif // DYNAMIC_ARRAY_PARALLEL_HEADER Included
@@ -0,0 +1,45 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	dynamic_array_sort.h - Private sorting helpers for the Dynamic Array
+//
+//	  Shared by dynamic_array.c and dynamic_array_parallel.c. Not part of the public API.
+//
+#ifndef DYNAMIC_ARRAY_SORT_HEADER
+#define DYNAMIC_ARRAY_SORT_HEADER
+
+#include <string.h>
+#include "dynamic_array.h"
+
+#define SORT_INSERTION_MAX  16      //Ranges this small are insertion sorted
+
+//Address of an element in a raw buffer
+#define ElAddr(base,index,size) ((void*) (((char*) (base)) + ((index) * (size))))
+
+
+//Copy a single element, with fast paths for the common sizes
+static inline void copy_element(void* to, const void* from, size_t size) {
+    switch(size) {
+        case 4: memcpy(to, from, 4); break;
+        case 8: memcpy(to, from, 8); break;
+        default: memcpy(to, from, size); break;
+    }
+}
+
+//temp must point to a buffer of at least one element
+static inline void insertion_sort(void* base, size_t n, size_t size, Compare_Func_t cmp, void* temp) {
+    size_t i;
+    for (i = 1; i < n; ++i) {
+        if (cmp(ElAddr(base,i-1,size), ElAddr(base,i,size)) <= 0) {continue;}
+
+        //Find where this element goes, then shift everything over once
+        copy_element(temp, ElAddr(base,i,size), size);
+        size_t j = i - 1;
+        while ((j > 0) && (cmp(temp, ElAddr(base,j-1,size)) < 0)) {--j;}
+
+        memmove(ElAddr(base,j+1,size), ElAddr(base,j,size), (i - j) * size);
+        copy_element(ElAddr(base,j,size), temp, size);
+    }
+}
+
+#endif // DYNAMIC_ARRAY_SORT_HEADER Included
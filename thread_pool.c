@@ -0,0 +1,208 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	thread_pool.c - Implementation for a reusable pool of worker threads
+//
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define CHUNKS_PER_THREAD 4		//Automatic grain size gives each thread about this many chunks
+
+
+//A single parallel loop
+typedef struct {
+	Task_Func_t func;
+	void* ctx;
+	size_t count;				// Total number of items
+	size_t grain;				// Items per chunk
+	size_t chunks;				// Total number of chunks
+	atomic_size_t next;			// Next chunk to hand out
+	atomic_size_t done;			// Number of chunks finished
+} Pool_Job_t, *pPool_Job_t;
+
+// Private Thread Pool object
+typedef struct {
+	pthread_t* workers;			// Worker threads (one less than the total thread count)
+	size_t num_workers;
+
+	pthread_mutex_t lock;		// Protects everything below
+	pthread_cond_t work_cv;		// Signaled when a new job is posted (or on shutdown)
+	pthread_cond_t done_cv;		// Signaled when a job finishes, or a worker lets go of it
+	pPool_Job_t job;			// Current job (NULL when idle)
+	size_t generation;			// Bumped for every new job
+	size_t active;				// Workers currently running the job
+	bool shutdown;
+
+	pthread_mutex_t run_lock;	// Only one parallel loop at a time
+} Pool_Obj_t, *pPool_Obj_t;
+
+
+
+//Grab and run chunks until there are none left
+//  Returns true if this thread finished the last chunk
+static bool pool_run_chunks(pPool_Job_t job) {
+	bool last = false;
+	while (1) {
+		size_t chunk = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+		if (chunk >= job->chunks) {break;}
+
+		size_t begin = chunk * job->grain;
+		size_t end = begin + job->grain;
+		if (end > job->count) {end = job->count;}
+		job->func(job->ctx, begin, end);
+
+		size_t done = atomic_fetch_add_explicit(&job->done, 1, memory_order_acq_rel) + 1;
+		if (done == job->chunks) {last = true;}
+	}
+	return last;
+}
+
+
+static void* pool_worker(void* arg) {
+	pPool_Obj_t pool = (pPool_Obj_t) arg;
+	size_t seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		while (!pool->shutdown && ((pool->generation == seen) || !pool->job)) {
+			if (pool->generation != seen) {seen = pool->generation;}
+			pthread_cond_wait(&pool->work_cv, &pool->lock);
+		}
+		if (pool->shutdown) {break;}
+
+		//Take part in the job, without holding the lock
+		pPool_Job_t job = pool->job;
+		seen = pool->generation;
+		pool->active+=1;
+		pthread_mutex_unlock(&pool->lock);
+
+		bool last = pool_run_chunks(job);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->active-=1;
+		if (last || (pool->active == 0)) {pthread_cond_broadcast(&pool->done_cv);}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+
+
+
+pThread_Pool_t new_thread_pool(size_t threads) {
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? (size_t) cpus : 1;
+	}
+
+	pPool_Obj_t pool = calloc(1, sizeof(Pool_Obj_t));
+	if (!pool) {return NULL;}
+
+	pool->workers = calloc(threads, sizeof(pthread_t));
+	if (!pool->workers) {free(pool); return NULL;}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->run_lock, NULL);
+	pthread_cond_init(&pool->work_cv, NULL);
+	pthread_cond_init(&pool->done_cv, NULL);
+
+	//The calling thread always helps out, so it only needs (threads - 1) workers
+	size_t i;
+	for (i = 0; i + 1 < threads; ++i) {
+		if (pthread_create(&pool->workers[i], NULL, pool_worker, pool) != 0) {break;}
+		pool->num_workers+=1;
+	}
+
+	return (pThread_Pool_t) pool;
+}
+
+
+void free_thread_pool(pThread_Pool_t p) {
+	pPool_Obj_t pool = (pPool_Obj_t) p;
+	if (!pool) {return;}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->work_cv);
+	pthread_mutex_unlock(&pool->lock);
+
+	size_t i;
+	for (i = 0; i < pool->num_workers; ++i) {
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->run_lock);
+	pthread_cond_destroy(&pool->work_cv);
+	pthread_cond_destroy(&pool->done_cv);
+	free(pool->workers);
+	free(pool);
+}
+
+
+size_t thread_pool_get_threads(pThread_Pool_t p) {
+	pPool_Obj_t pool = (pPool_Obj_t) p;
+	if (!pool) {return 1;}
+	return pool->num_workers + 1;
+}
+
+
+size_t thread_pool_auto_grain(pThread_Pool_t pool, size_t count) {
+	size_t grain = count / (thread_pool_get_threads(pool) * CHUNKS_PER_THREAD);
+	return (grain > 0) ? grain : 1;
+}
+
+
+bool thread_pool_parallel_for(pThread_Pool_t p, size_t count, size_t grain, Task_Func_t func, void* ctx) {
+	pPool_Obj_t pool = (pPool_Obj_t) p;
+	if (!func) {return false;}
+	if (count == 0) {return true;}
+
+	if (grain == 0) {grain = thread_pool_auto_grain(pool, count);}
+
+	//Not worth waking anybody up
+	if (!pool || (pool->num_workers == 0) || (count <= grain)) {
+		size_t begin;
+		for (begin = 0; begin < count; begin+=grain) {
+			func(ctx, begin, ((count - begin) < grain) ? count : (begin + grain));
+		}
+		return true;
+	}
+
+	Pool_Job_t job;
+	job.func = func;
+	job.ctx = ctx;
+	job.count = count;
+	job.grain = grain;
+	job.chunks = (count / grain) + ((count % grain) ? 1 : 0);
+	atomic_init(&job.next, 0);
+	atomic_init(&job.done, 0);
+
+	pthread_mutex_lock(&pool->run_lock);
+
+	//Post the job, then help out
+	pthread_mutex_lock(&pool->lock);
+	pool->job = &job;
+	pool->generation+=1;
+	pthread_cond_broadcast(&pool->work_cv);
+	pthread_mutex_unlock(&pool->lock);
+
+	pool_run_chunks(&job);
+
+	//Wait for the last chunk, then for every worker to let go of the job (it lives on this stack)
+	pthread_mutex_lock(&pool->lock);
+	while (atomic_load_explicit(&job.done, memory_order_acquire) < job.chunks) {
+		pthread_cond_wait(&pool->done_cv, &pool->lock);
+	}
+	pool->job = NULL;
+	while (pool->active > 0) {
+		pthread_cond_wait(&pool->done_cv, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_mutex_unlock(&pool->run_lock);
+	return true;
+}
@@ -0,0 +1,36 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	thread_pool.h - Header for a reusable pool of worker threads
+//
+//	  The pool runs one parallel loop at a time: the range [0, count) is split into chunks of
+//	  grain items, which the workers (and the calling thread) grab until none are left.
+//
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+#include <stddef.h>	/* For size_t */
+#include <stdbool.h>
+
+typedef void *pThread_Pool_t;
+
+//Called once per chunk, with the range [begin, end)
+typedef void (*Task_Func_t)(void* ctx, size_t begin, size_t end);
+
+
+//threads is the total number of threads running each loop, including the caller
+//  Use 0 for one thread per CPU
+pThread_Pool_t new_thread_pool(size_t threads);
+void free_thread_pool(pThread_Pool_t pool);
+
+size_t thread_pool_get_threads(pThread_Pool_t pool);
+
+//The grain size used when 0 is passed to thread_pool_parallel_for() (never less than 1)
+size_t thread_pool_auto_grain(pThread_Pool_t pool, size_t count);
+
+//Run func over every chunk of [0, count), then wait for all of them to finish
+//  A grain of 0 picks one automatically. If pool is NULL, everything runs on the calling thread
+//  Calls from several threads at once are run one after the other
+bool thread_pool_parallel_for(pThread_Pool_t pool, size_t count, size_t grain, Task_Func_t func, void* ctx);
+
+#endif // THREAD_POOL_HEADER Included
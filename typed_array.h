@@ -0,0 +1,95 @@
+// C Data Structures
+// (C) Comprosoft 2018 - All Rights Reserved
+//
+//	typed_array.h - Compile-time typed wrapper around the Dynamic Array
+//
+//	  DEFINE_DYNAMIC_ARRAY(name, T) generates a name_t struct along with static inline
+//	  functions that access the elements through a T* pointer. The compiler can inline and
+//	  specialize every access, while growth is still handled by dynamic_array.c
+//
+//	  Example:
+//	    DEFINE_DYNAMIC_ARRAY(point_array, Point_t)
+//
+//	    point_array_t points;
+//	    point_array_init(&points);
+//	    point_array_push(&points, p);
+//	    Point_t first = point_array_get(&points, 0);
+//	    point_array_free(&points, NULL);
+//
+//	  The wrapper caches the element count. Call name_sync() before passing name.arr to any
+//	  function from dynamic_array.h, and name_refresh() afterwards if that function could
+//	  have changed the array.
+//
+#ifndef TYPED_ARRAY_HEADER
+#define TYPED_ARRAY_HEADER
+
+#include "dynamic_array.h"
+
+#define DEFINE_DYNAMIC_ARRAY(name, T)                                                       \
+                                                                                            \
+typedef struct {                                                                            \
+    pDynamic_Arr_t arr;     /* Underlying Dynamic Array (owns the buffer) */                \
+    T* data;                /* Typed view of the element buffer */                          \
+    size_t count;           /* Number of elements in use */                                 \
+    size_t capacity;        /* Number of elements that fit before growing */                \
+} name##_t;                                                                                 \
+                                                                                            \
+/* Reload the cached buffer pointer, count and capacity from the Dynamic Array */           \
+static inline void name##_refresh(name##_t* a) {                                            \
+    a->data = (T*) get_array_data(a->arr);                                                  \
+    a->count = get_array_count(a->arr);                                                     \
+    a->capacity = get_array_capacity(a->arr);                                               \
+}                                                                                           \
+                                                                                            \
+/* Write the cached count back, then return the Dynamic Array */                            \
+static inline pDynamic_Arr_t name##_sync(name##_t* a) {                                     \
+    if (a->data) {set_array_count(a->arr, a->count);}                                       \
+    return a->arr;                                                                          \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_init(name##_t* a) {                                               \
+    a->arr = new_dynamic_array(sizeof(T));                                                  \
+    a->data = NULL;                                                                         \
+    a->count = a->capacity = 0;                                                             \
+    return (a->arr != NULL);                                                                \
+}                                                                                           \
+                                                                                            \
+static inline void name##_free(name##_t* a, Free_Func_t func) {                             \
+    free_dynamic_array(name##_sync(a), func);                                               \
+    a->arr = NULL;                                                                          \
+    a->data = NULL;                                                                         \
+    a->count = a->capacity = 0;                                                             \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_reserve(name##_t* a, size_t count) {                              \
+    bool ret = reserve_array(name##_sync(a), count);                                        \
+    name##_refresh(a);                                                                      \
+    return ret;                                                                             \
+}                                                                                           \
+                                                                                            \
+/* Slow path for push: let the Dynamic Array grow the buffer */                             \
+static inline bool name##_push_grow(name##_t* a, const T* value) {                          \
+    bool ret = add_array_element(name##_sync(a), value);                                    \
+    name##_refresh(a);                                                                      \
+    return ret;                                                                             \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_push(name##_t* a, T value) {                                      \
+    if (a->count < a->capacity) {a->data[a->count++] = value; return true;}                 \
+    return name##_push_grow(a, &value);                                                     \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_pop(name##_t* a, T* value) {                                      \
+    if (a->count == 0) {return false;}                                                      \
+    a->count-=1;                                                                            \
+    if (value) {*value = a->data[a->count];}                                                \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+/* No bounds checking, just like a plain C array */                                         \
+static inline T name##_get(const name##_t* a, size_t index) {return a->data[index];}       \
+static inline T* name##_at(const name##_t* a, size_t index) {return &a->data[index];}      \
+static inline void name##_set(name##_t* a, size_t index, T value) {a->data[index] = value;} \
+static inline size_t name##_count(const name##_t* a) {return a->count;}
+
+#endif // TYPED_ARRAY_HEADER Included
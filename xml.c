@@ -3,7 +3,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdarg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define XML_WRITE_FD
+#include <errno.h>
+#include <unistd.h>
+#endif
 
 
 //Dynamic array buffer structure type
@@ -34,28 +39,55 @@ typedef struct XML_PNODE_t {
 
 	BUFFER_t attrib_buffer;				// For creating a list of attributes
 	BUFFER_t child_buffer;				// For creating a list of children
+	pAllocator_t alloc;					// Where all memory comes from (NULL for malloc/free)
 } XML_PNODE_t, *pXML_PNODE_t;
 
 
+//Private XML attribute ([P]rivate [Attrib], or PATTRIB)
+typedef struct {
+	char* name;
+	char* value;
+
+//------------Private Variables--------------
+
+	pAllocator_t alloc;					// Where all memory comes from (NULL for malloc/free)
+} XML_PATTRIB_t, *pXML_PATTRIB_t;
+
+
 
 
 
 
 //************************Other Functions***************************
 
-static inline char* dupstr(const char* input) {
+static inline char* dupstr(pAllocator_t alloc, const char* input) {
 	if (!input) {return NULL;}
 
-	char* buf = malloc(strlen(input) + 1);
+	size_t len = strlen(input) + 1;
+	char* buf = mem_alloc(alloc, len);
 	if (!buf) {return NULL;}
-	strcpy(buf,input);
+	memcpy(buf,input,len);
 	return buf;
 }
 
+static inline void freestr(pAllocator_t alloc, char* str) {
+	if (str) {mem_free(alloc, str, strlen(str) + 1);}
+}
+
+
+//Documents release everything at once, so freeing anything inside of one does nothing
+static void doc_free(void* ctx, void* ptr, size_t size) {
+	(void) ctx; (void) ptr; (void) size;
+}
+
+static inline bool in_document(pAllocator_t alloc) {
+	return alloc && (alloc->free == doc_free);
+}
+
 
-static inline void set_string(char** ptr, char* string, bool copy) {
-	if (*ptr) {free(*ptr);}
-	if (copy) {*ptr = dupstr(string);}
+static inline void set_string(pAllocator_t alloc, char** ptr, char* string, bool copy) {
+	freestr(alloc, *ptr);
+	if (copy) {*ptr = dupstr(alloc, string);}
 	else {*ptr = string;}
 }
 
@@ -71,12 +103,14 @@ static inline void buffer_update(pBUFFER_t buf) {
 }
 
 
-static inline void copy_buffer_size(pBUFFER_t from, pBUFFER_t to) {
-	if (to->arr) {free(to->arr);}
+static inline void copy_buffer_size(pAllocator_t alloc, pBUFFER_t from, pBUFFER_t to) {
+	mem_free(alloc, to->arr, to->alloc * sizeof(void*));
 	
 	to->inuse = from->inuse;
 	to->alloc = from->alloc;
-	to->arr = (void**) calloc(to->alloc,sizeof(void*));
+	to->arr = (void**) mem_alloc(alloc, to->alloc * sizeof(void*));
+	if (to->arr) {memset(to->arr, 0, to->alloc * sizeof(void*));}
+	else {to->inuse = to->alloc = 0;}
 
 	//memcpy(to->arr,from->arr,sizeof(void*) * to->inuse);
 	buffer_update(to);
@@ -86,28 +120,34 @@ static inline void copy_buffer_size(pBUFFER_t from, pBUFFER_t to) {
 
 
 #define INITIAL_SIZE  16
-#define INCREASE_SIZE 16
-
-static inline void insert_buffer(pBUFFER_t buf, void* ptr) {
-	if (!(buf->arr)) {		//Initial Allocation
-		buf->alloc = INITIAL_SIZE;
-		buf->arr = (void **) calloc(buf->alloc,sizeof(void*));
-	}
 
-	buf->arr[buf->inuse++] = ptr;
+//Returns false if the buffer couldn't grow (it keeps its old array, and ptr is not added)
+static inline bool insert_buffer(pAllocator_t alloc, pBUFFER_t buf, void* ptr) {
+	if (!(buf->arr) || (buf->inuse >= buf->alloc)) {
+		void** arr;
+		size_t new_alloc;
+		if (!(buf->arr)) {		//Initial Allocation
+			new_alloc = INITIAL_SIZE;
+			arr = (void**) mem_alloc(alloc, new_alloc * sizeof(void*));
+		} else {				//Double every time (arenas never get old arrays back)
+			new_alloc = buf->alloc * 2;
+			arr = (void**) mem_realloc(alloc, buf->arr, buf->alloc * sizeof(void*), new_alloc * sizeof(void*));
+		}
+		if (!arr) {return false;}
 
-	if (buf->inuse >= buf->alloc) {	//Resize by X every time
-		buf->alloc+=INCREASE_SIZE;
-		buf->arr = (void**) realloc(buf->arr,(buf->alloc) * sizeof(void*));
+		buf->arr = arr;
+		buf->alloc = new_alloc;
 	}
 
+	buf->arr[buf->inuse++] = ptr;
 	buffer_update(buf);
+	return true;
 }
 
 
 
-static inline void free_buffer(pBUFFER_t buf) {
-	if (buf->arr) {free(buf->arr); buf->arr = NULL;}
+static inline void free_buffer(pAllocator_t alloc, pBUFFER_t buf) {
+	if (buf->arr) {mem_free(alloc, buf->arr, buf->alloc * sizeof(void*)); buf->arr = NULL;}
 	buf->inuse = buf->alloc = 0;
 	buffer_update(buf);
 }
@@ -116,34 +156,55 @@ static inline void free_buffer(pBUFFER_t buf) {
 //************************XML Attributes***************************
 
 pXML_ATTRIB_t new_xml_attrib() {
-	pXML_ATTRIB_t attr = (pXML_ATTRIB_t) calloc(1,sizeof(XML_ATTRIB_t));
+	return new_xml_attrib_alloc(NULL);
+}
 
-	//Default name and value strings
-	attr->name = dupstr("NAME");
-	attr->value = dupstr("VALUE");
+//An attribute without a name or value
+static pXML_PATTRIB_t alloc_xml_attrib(pAllocator_t alloc) {
+	pXML_PATTRIB_t attr = (pXML_PATTRIB_t) mem_alloc(alloc, sizeof(XML_PATTRIB_t));
+	if (!attr) {return NULL;}
+	attr->name = NULL;
+	attr->value = NULL;
+	attr->alloc = alloc;
 	return attr;
 }
 
-pXML_ATTRIB_t duplicate_xml_attrib(pXML_ATTRIB_t attr) {
-	pXML_ATTRIB_t new = new_xml_attrib();
+pXML_ATTRIB_t new_xml_attrib_alloc(pAllocator_t alloc) {
+	pXML_PATTRIB_t attr = alloc_xml_attrib(alloc);
+	if (!attr) {return NULL;}
+
+	//Default name and value strings
+	attr->name = dupstr(alloc, "NAME");
+	attr->value = dupstr(alloc, "VALUE");
+	return (pXML_ATTRIB_t) attr;
+}
+
+static pXML_ATTRIB_t duplicate_xml_attrib_alloc(pXML_ATTRIB_t attr, pAllocator_t alloc) {
+	pXML_ATTRIB_t new = new_xml_attrib_alloc(alloc);
+	if (!new) {return NULL;}
 
 	if (attr->name) {xml_attrib_set_name(new,attr->name,true);}
 	if (attr->value) {xml_attrib_set_value(new,attr->value,true);}
 	return new;
 }
 
-void free_xml_attrib(pXML_ATTRIB_t attr) {
-	if (attr->name)  {free(attr->name);}
-	if (attr->value) {free(attr->value);}
-	free(attr);
+pXML_ATTRIB_t duplicate_xml_attrib(pXML_ATTRIB_t attr) {
+	return duplicate_xml_attrib_alloc(attr, ((pXML_PATTRIB_t) attr)->alloc);
+}
+
+void free_xml_attrib(pXML_ATTRIB_t a) {
+	pXML_PATTRIB_t attr = (pXML_PATTRIB_t) a;
+	freestr(attr->alloc, attr->name);
+	freestr(attr->alloc, attr->value);
+	mem_free(attr->alloc, attr, sizeof(XML_PATTRIB_t));
 }
 
 void xml_attrib_set_name(pXML_ATTRIB_t attr, char* name, bool copy) {
-	set_string(&attr->name,name,copy);
+	set_string(((pXML_PATTRIB_t) attr)->alloc,&attr->name,name,copy);
 }
 
 void xml_attrib_set_value(pXML_ATTRIB_t attr, char* value, bool copy) {
-	set_string(&attr->value,value,copy);
+	set_string(((pXML_PATTRIB_t) attr)->alloc,&attr->value,value,copy);
 }
 
 
@@ -154,11 +215,15 @@ void xml_attrib_set_value(pXML_ATTRIB_t attr, char* value, bool copy) {
 //************************XML Nodes***************************
 
 pXML_NODE_t new_xml_node() {
-	pXML_PNODE_t node = calloc(1,sizeof(XML_PNODE_t));
+	return new_xml_node_alloc(NULL);
+}
 
-	//Default Values
-	node->name = dupstr("NAME");
-	node->value = dupstr("VALUE");
+//A node without a name or value
+static pXML_PNODE_t alloc_xml_node(pAllocator_t alloc) {
+	pXML_PNODE_t node = mem_alloc(alloc, sizeof(XML_PNODE_t));
+	if (!node) {return NULL;}
+	memset(node, 0, sizeof(XML_PNODE_t));
+	node->alloc = alloc;
 
 	//Update Buffer Pointers
 	node->attrib_buffer.updateLen = &node->num_attrib;
@@ -166,43 +231,79 @@ pXML_NODE_t new_xml_node() {
 	node->child_buffer.updateLen = &node->num_children;
 	node->child_buffer.updateArr = (void***) &node->children;
 
+	return node;
+}
+
+pXML_NODE_t new_xml_node_alloc(pAllocator_t alloc) {
+	pXML_PNODE_t node = alloc_xml_node(alloc);
+	if (!node) {return NULL;}
+
+	//Default Values
+	node->name = dupstr(alloc, "NAME");
+	node->value = dupstr(alloc, "VALUE");
+
 	return (pXML_NODE_t) node;
 }
 
 
-pXML_NODE_t duplicate_xml_node(pXML_NODE_t n) {
+//Frees a copy that ran out of memory part way through,
+//  keeping only the first attribs attributes and children children
+static pXML_NODE_t discard_partial_node(pXML_PNODE_t new, size_t attribs, size_t children) {
+	new->attrib_buffer.inuse = attribs;
+	new->child_buffer.inuse = children;
+	buffer_update(&new->attrib_buffer);
+	buffer_update(&new->child_buffer);
+	free_xml_node((pXML_NODE_t) new);
+	return NULL;
+}
+
+//The copy (and everything under it) comes from alloc
+//  Returns NULL (and copies nothing) if memory runs out
+static pXML_NODE_t duplicate_xml_node_alloc(pXML_NODE_t n, pAllocator_t alloc) {
 
 	pXML_PNODE_t node = (pXML_PNODE_t) n;
-	pXML_PNODE_t new = (pXML_PNODE_t) new_xml_node();	
+	pXML_PNODE_t new = (pXML_PNODE_t) new_xml_node_alloc(alloc);
+	if (!new) {return NULL;}
 
 	if (node->name) {xml_set_name((pXML_NODE_t) new,node->name,true);}
 	if (node->value) {xml_set_value((pXML_NODE_t) new,node->value,true);}
 
 	//Note: Copy buffer updates num_attrib, attrib, num_children, and children
-	copy_buffer_size(&node->attrib_buffer,&new->attrib_buffer);
-	copy_buffer_size(&node->child_buffer,&new->child_buffer);
+	copy_buffer_size(alloc,&node->attrib_buffer,&new->attrib_buffer);
+	copy_buffer_size(alloc,&node->child_buffer,&new->child_buffer);
+	if ((new->num_attrib != node->num_attrib) || (new->num_children != node->num_children)) {
+		return discard_partial_node(new, 0, 0);
+	}
 
 	//Copy attrbutes
 	size_t i;
-	for (i = 0; i < node->num_attrib; ++i) {
-		new->attrib[i] = duplicate_xml_attrib(node->attrib[i]);
+	for (i = 0; i < new->num_attrib; ++i) {
+		new->attrib[i] = duplicate_xml_attrib_alloc(node->attrib[i], alloc);
+		if (!new->attrib[i]) {return discard_partial_node(new, i, 0);}
 	}
 
 	//Copy children
-	for (i = 0; i < node->num_children; ++i) {
-		new->children[i] = (pXML_PNODE_t) duplicate_xml_node((pXML_NODE_t) node->children[i]);
+	for (i = 0; i < new->num_children; ++i) {
+		new->children[i] = (pXML_PNODE_t) duplicate_xml_node_alloc((pXML_NODE_t) node->children[i], alloc);
+		if (!new->children[i]) {return discard_partial_node(new, new->num_attrib, i);}
+		new->children[i]->parent = new;
 	}
 
 	return (pXML_NODE_t) new;
 }
 
+pXML_NODE_t duplicate_xml_node(pXML_NODE_t n) {
+	return duplicate_xml_node_alloc(n, ((pXML_PNODE_t) n)->alloc);
+}
 
 
 
-//Does this recursively
+
+//Does this recursively (unless the node is part of a document, which frees it later)
 void free_xml_node(pXML_NODE_t n) {
 	size_t i;
 	pXML_PNODE_t node = (pXML_PNODE_t) n;
+	if (in_document(node->alloc)) {return;}
 
 	//Free attributes
 	for (i = 0; i < node->num_attrib; ++i) {
@@ -214,154 +315,1283 @@ void free_xml_node(pXML_NODE_t n) {
 		free_xml_node((pXML_NODE_t) node->children[i]);
 	}
 
-	free_buffer(&node->attrib_buffer);
-	free_buffer(&node->child_buffer);
+	free_buffer(node->alloc,&node->attrib_buffer);
+	free_buffer(node->alloc,&node->child_buffer);
 	
-	if (node->name) {free(node->name);}
-	if (node->value) {free(node->value);}
+	freestr(node->alloc,node->name);
+	freestr(node->alloc,node->value);
 
-	free(node);
+	mem_free(node->alloc,node,sizeof(XML_PNODE_t));
 }
 
 
 
 void xml_set_name(pXML_NODE_t node, char* name, bool copy) {
-	set_string(&((pXML_PNODE_t)node)->name,name,copy);
+	set_string(((pXML_PNODE_t)node)->alloc,&((pXML_PNODE_t)node)->name,name,copy);
 }
 
 void xml_set_value(pXML_NODE_t node, char* value, bool copy) {
-	set_string(&((pXML_PNODE_t)node)->value,value,copy);
+	set_string(((pXML_PNODE_t)node)->alloc,&((pXML_PNODE_t)node)->value,value,copy);
 }
 
 
-void xml_add_attrib(pXML_NODE_t n, pXML_ATTRIB_t attr, bool copy) {
+bool xml_add_attrib(pXML_NODE_t n, pXML_ATTRIB_t attr, bool copy) {
 	pXML_PNODE_t node = (pXML_PNODE_t) n;
 	if (copy) {
-		insert_buffer(&node->attrib_buffer,duplicate_xml_attrib(attr));
-	} else {
-		insert_buffer(&node->attrib_buffer,attr);
+		pXML_ATTRIB_t new = duplicate_xml_attrib_alloc(attr,node->alloc);
+		if (!new) {return false;}
+		if (!insert_buffer(node->alloc,&node->attrib_buffer,new)) {free_xml_attrib(new); return false;}
+		return true;
 	}
+	return insert_buffer(node->alloc,&node->attrib_buffer,attr);
 }
 
-void xml_add_child_node(pXML_NODE_t n, pXML_NODE_t child, bool copy) {
+bool xml_add_child_node(pXML_NODE_t n, pXML_NODE_t child, bool copy) {
 	pXML_PNODE_t node = (pXML_PNODE_t) n;
-	((pXML_PNODE_t)child)->parent = node;
 	if (copy) {	
-		insert_buffer(&node->child_buffer,duplicate_xml_node(child));
+		pXML_PNODE_t new = (pXML_PNODE_t) duplicate_xml_node_alloc(child,node->alloc);
+		if (!new) {return false;}
+		if (!insert_buffer(node->alloc,&node->child_buffer,new)) {free_xml_node((pXML_NODE_t) new); return false;}
+		new->parent = node;
+		return true;
+	}
+
+	if (!insert_buffer(node->alloc,&node->child_buffer,child)) {return false;}
+	((pXML_PNODE_t)child)->parent = node;
+	return true;
+}
+
+
+
+
+//************************Parsing***************************
+
+//An element that has been opened, but not closed yet
+typedef struct {
+	pXML_PNODE_t node;
+	size_t text_start;		// Where its text starts in the parser's text buffer
+	size_t child_start;		// Where its children start in the parser's list of finished nodes
+} XML_OPEN_t;
+
+//Parser state
+//	Children (and attributes) wait in a list until their parent is done, so every array is allocated once
+typedef struct {
+	const char* p;			// Next character to read
+	const char* end;
+	pAllocator_t alloc;		// Where the tree comes from (temporary buffers always use malloc)
+
+	char* text;				// Decoded text of every open element, innermost last
+	size_t text_len, text_alloc;
+
+	XML_OPEN_t* open;		// Stack of open elements
+	size_t open_len, open_alloc;
+
+	pXML_PNODE_t* nodes;	// Finished nodes that have not been given to their parent yet
+	size_t nodes_len, nodes_alloc;
+
+	pXML_PATTRIB_t* attribs;	// Attributes of the start tag being read
+	size_t attribs_len, attribs_alloc;
+
+	pXML_PNODE_t root;
+} XML_PARSER_t, *pXML_PARSER_t;
+
+
+//Make sure a temporary array has room for need items (doubling its size)
+static bool parser_reserve(void** arr, size_t* alloc, size_t need, size_t item) {
+	if (need <= *alloc) {return true;}
+
+	size_t new_alloc = (*alloc > 0) ? (*alloc * 2) : INITIAL_SIZE;
+	while (new_alloc < need) {new_alloc*=2;}
+
+	void* new = realloc(*arr, new_alloc * item);
+	if (!new) {return false;}
+	*arr = new;
+	*alloc = new_alloc;
+	return true;
+}
+
+#define PARSER_PUSH(ps,arr,len,alloc,item) \
+	(parser_reserve((void**) &(ps)->arr, &(ps)->alloc, (ps)->len + 1, sizeof(*(ps)->arr)) && \
+	(((ps)->arr[(ps)->len++] = (item)), true))
+
+
+static inline bool is_space(char c) {
+	return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+//Names end at whitespace or at anything that has a meaning inside of a tag
+static inline bool is_name_end(char c) {
+	return is_space(c) || (c == '/') || (c == '>') || (c == '=') || (c == '<') || (c == '"') || (c == '\'');
+}
+
+static inline void skip_space(pXML_PARSER_t ps) {
+	while ((ps->p < ps->end) && is_space(*ps->p)) {++ps->p;}
+}
+
+static inline bool starts_with(pXML_PARSER_t ps, const char* str, size_t len) {
+	return ((size_t) (ps->end - ps->p) >= len) && (memcmp(ps->p, str, len) == 0);
+}
+
+//Move past the next copy of str, or return false if there isn't one
+static bool skip_past(pXML_PARSER_t ps, const char* str, size_t len) {
+	const char* p = ps->p;
+	while ((size_t) (ps->end - p) >= len) {
+		p = memchr(p, str[0], (size_t) (ps->end - p) - len + 1);
+		if (!p) {break;}
+		if (memcmp(p, str, len) == 0) {ps->p = p + len; return true;}
+		++p;
+	}
+	return false;
+}
+
+
+//String from the tree's allocator (sized so that freestr() works on it)
+static char* parser_string(pXML_PARSER_t ps, const char* str, size_t len) {
+	char* buf = mem_alloc(ps->alloc, len + 1);
+	if (!buf) {return NULL;}
+	if (len > 0) {memcpy(buf, str, len);}
+	buf[len] = '\0';
+	return buf;
+}
+
+static bool parser_add_text(pXML_PARSER_t ps, const char* str, size_t len) {
+	if (len == 0) {return true;}
+	if (!parser_reserve((void**) &ps->text, &ps->text_alloc, ps->text_len + len, 1)) {return false;}
+	memcpy(ps->text + ps->text_len, str, len);
+	ps->text_len += len;
+	return true;
+}
+
+
+//Decode the entity at p (just past the '&') into out, which needs room for 4 bytes
+//	The output is never longer than the entity itself
+//	Returns the number of bytes written (0 if it is not a valid entity), and moves p past the ';'
+static size_t decode_entity(const char** pp, const char* end, char* out) {
+	const char* p = *pp;
+	const char* semi = memchr(p, ';', (size_t) (end - p));
+	if (!semi) {return 0;}
+	size_t len = (size_t) (semi - p);
+	*pp = semi + 1;
+
+	if ((len == 2) && !memcmp(p, "lt", 2)) {*out = '<'; return 1;}
+	if ((len == 2) && !memcmp(p, "gt", 2)) {*out = '>'; return 1;}
+	if ((len == 3) && !memcmp(p, "amp", 3)) {*out = '&'; return 1;}
+	if ((len == 4) && !memcmp(p, "quot", 4)) {*out = '"'; return 1;}
+	if ((len == 4) && !memcmp(p, "apos", 4)) {*out = '\''; return 1;}
+	if ((len < 2) || (*p != '#')) {return 0;}
+
+	//Character reference, written out as UTF-8
+	unsigned long code = 0;
+	bool hex = (p[1] == 'x');
+	const char* c;
+	for (c = p + (hex ? 2 : 1); c < semi; ++c) {
+		int digit;
+		if ((*c >= '0') && (*c <= '9')) {digit = *c - '0';}
+		else if (hex && (*c >= 'a') && (*c <= 'f')) {digit = *c - 'a' + 10;}
+		else if (hex && (*c >= 'A') && (*c <= 'F')) {digit = *c - 'A' + 10;}
+		else {return 0;}
+
+		code = code * (hex ? 16 : 10) + (unsigned long) digit;
+		if (code > 0x10FFFF) {return 0;}
+	}
+	if ((c == p + (hex ? 2 : 1)) || (code == 0)) {return 0;}
+
+	if (code < 0x80) {out[0] = (char) code; return 1;}
+	if (code < 0x800) {
+		out[0] = (char) (0xC0 | (code >> 6));
+		out[1] = (char) (0x80 | (code & 0x3F));
+		return 2;
+	}
+	if (code < 0x10000) {
+		out[0] = (char) (0xE0 | (code >> 12));
+		out[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+		out[2] = (char) (0x80 | (code & 0x3F));
+		return 3;
+	}
+	out[0] = (char) (0xF0 | (code >> 18));
+	out[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+	out[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+	out[3] = (char) (0x80 | (code & 0x3F));
+	return 4;
+}
+
+//Decode [str, end) into out, which never needs more room than the input
+//	Returns the number of bytes written, or -1 if there is a bad entity
+static size_t decode_text(const char* str, const char* end, char* out) {
+	char* start = out;
+	while (str < end) {
+		const char* amp = memchr(str, '&', (size_t) (end - str));
+		if (!amp) {amp = end;}
+		memcpy(out, str, (size_t) (amp - str));
+		out += amp - str;
+		if (amp == end) {break;}
+
+		str = amp + 1;
+		size_t n = decode_entity(&str, end, out);	//Always shorter than the entity itself
+		if (n == 0) {return -1;}
+		out += n;
+	}
+	return (size_t) (out - start);
+}
+
+//Add [str, end) to the text buffer, decoding any entities
+static bool parser_decode(pXML_PARSER_t ps, const char* str, const char* end) {
+	if (!parser_reserve((void**) &ps->text, &ps->text_alloc, ps->text_len + (size_t) (end - str), 1)) {return false;}
+
+	size_t len = decode_text(str, end, ps->text + ps->text_len);
+	if (len == (size_t) -1) {return false;}
+	ps->text_len += len;
+	return true;
+}
+
+
+//Skip everything that can come before or after the root element: whitespace, comments,
+//	processing instructions (including the XML declaration) and the DOCTYPE
+static bool parser_skip_misc(pXML_PARSER_t ps) {
+	while (true) {
+		skip_space(ps);
+		if (starts_with(ps, "<!--", 4)) {
+			ps->p += 4;
+			if (!skip_past(ps, "-->", 3)) {return false;}
+		} else if (starts_with(ps, "<?", 2)) {
+			if (!skip_past(ps, "?>", 2)) {return false;}
+		} else if (starts_with(ps, "<!DOCTYPE", 9)) {
+
+			//The internal subset (in brackets) can have '>' inside of it
+			size_t depth = 0;
+			char quote = 0;
+			for (ps->p += 9; ps->p < ps->end; ++ps->p) {
+				char c = *ps->p;
+				if (quote) {if (c == quote) {quote = 0;}}
+				else if ((c == '"') || (c == '\'')) {quote = c;}
+				else if (c == '[') {++depth;}
+				else if (c == ']') {if (depth > 0) {--depth;}}
+				else if ((c == '>') && (depth == 0)) {break;}
+			}
+			if (ps->p >= ps->end) {return false;}
+			++ps->p;
+		} else {
+			return true;
+		}
+	}
+}
+
+
+//Give a node's buffer exactly the items in list[start..len), then take them off of the list
+static bool parser_take(pXML_PARSER_t ps, pBUFFER_t buf, void** list, size_t start, size_t* len) {
+	size_t n = *len - start;
+	if (n == 0) {return true;}
+
+	//One extra slot, so the next insert_buffer() doesn't have to grow it right away
+	buf->arr = (void**) mem_alloc(ps->alloc, (n + 1) * sizeof(void*));
+	if (!buf->arr) {return false;}
+	memcpy(buf->arr, list + start, n * sizeof(void*));
+	buf->arr[n] = NULL;
+
+	buf->inuse = n;
+	buf->alloc = n + 1;
+	buffer_update(buf);
+	*len = start;
+	return true;
+}
+
+
+//Open a new element inside of the innermost one
+//	Its attributes are added with parser_attrib(), then parser_open_done() hands them over
+static bool parser_open(pXML_PARSER_t ps, const char* name, size_t len) {
+	XML_OPEN_t open;
+	open.node = alloc_xml_node(ps->alloc);
+	open.text_start = ps->text_len;
+	open.child_start = ps->nodes_len;
+	if (!open.node) {return false;}
+	if (!PARSER_PUSH(ps, open, open_len, open_alloc, open)) {
+		free_xml_node((pXML_NODE_t) open.node);
+		return false;
+	}
+
+	open.node->name = parser_string(ps, name, len);
+	return (open.node->name != NULL);
+}
+
+//The value is decoded first if decode is true
+static bool parser_attrib(pXML_PARSER_t ps, const char* name, size_t name_len, const char* value, size_t value_len, bool decode) {
+	pXML_PATTRIB_t attr = alloc_xml_attrib(ps->alloc);
+	if (!attr) {return false;}
+	if (!PARSER_PUSH(ps, attribs, attribs_len, attribs_alloc, attr)) {
+		free_xml_attrib((pXML_ATTRIB_t) attr);
+		return false;
+	}
+
+	attr->name = parser_string(ps, name, name_len);
+	if (decode) {
+
+		//Decoded at the end of the text buffer, then taken back off
+		size_t mark = ps->text_len;
+		if (!parser_decode(ps, value, value + value_len)) {return false;}
+		attr->value = parser_string(ps, ps->text + mark, ps->text_len - mark);
+		ps->text_len = mark;
 	} else {
-		insert_buffer(&node->child_buffer,child);
-	}	
+		attr->value = parser_string(ps, value, value_len);
+	}
+	return (attr->name && attr->value);
 }
 
+static bool parser_open_done(pXML_PARSER_t ps) {
+	pXML_PNODE_t node = ps->open[ps->open_len - 1].node;
+	return parser_take(ps, &node->attrib_buffer, (void**) ps->attribs, 0, &ps->attribs_len);
+}
 
 
+//Read a start tag (p is just past the '<'), and open the element
+static bool parser_start_tag(pXML_PARSER_t ps) {
+	const char* name = ps->p;
+	while ((ps->p < ps->end) && !is_name_end(*ps->p)) {++ps->p;}
+	if (ps->p == name) {return false;}
+	if (!parser_open(ps, name, (size_t) (ps->p - name))) {return false;}
+
+	//Attributes
+	while (true) {
+		const char* attr_name = ps->p;
+		skip_space(ps);
+		if (ps->p >= ps->end) {return false;}
+		if ((*ps->p == '>') || (*ps->p == '/')) {break;}
+		if (ps->p == attr_name) {return false;}	//Needs whitespace before it
+
+		attr_name = ps->p;
+		while ((ps->p < ps->end) && !is_name_end(*ps->p)) {++ps->p;}
+		size_t name_len = (size_t) (ps->p - attr_name);
+
+		skip_space(ps);
+		if ((name_len == 0) || (ps->p >= ps->end) || (*ps->p != '=')) {return false;}
+		++ps->p;
+		skip_space(ps);
+		if ((ps->p >= ps->end) || ((*ps->p != '"') && (*ps->p != '\''))) {return false;}
+
+		const char* value = ps->p + 1;
+		const char* close = memchr(value, *ps->p, (size_t) (ps->end - value));
+		if (!close) {return false;}
+		ps->p = close + 1;
+
+		if (!parser_attrib(ps, attr_name, name_len, value, (size_t) (close - value), true)) {return false;}
+	}
 
-//************************Print and Debug***************************
+	return parser_open_done(ps);
+}
 
 
+//Close the innermost element: its text becomes its value, and its children are handed over
+static bool parser_end_element(pXML_PARSER_t ps) {
+	XML_OPEN_t* open = &ps->open[ps->open_len - 1];
+	pXML_PNODE_t node = open->node;
 
-// Similar to printf, but concatenates the string
-//	Automatically resizes buf to accomidate the new string
-//
-// Upon failure, returns false and frees the buffer
-static bool sprintf_cat(char** pBuf, const char* format, ...) {
-	
-	va_list vl;
-	char* buf = *pBuf;
-
-	//Get the number of characters to append to the buffer
-	va_start(vl,format);
-	int chars = vsnprintf(NULL,0,format,vl);
-	va_end(vl);
-	if (chars < 0) {return free(buf), false; /* Print Error */}
-
-	//Figure out the new length needed for the String buffer
-	size_t curLen = ((buf != NULL) ? strlen(buf) : 0);
-	size_t newLen = curLen+chars+1;		//Don't forget null terminator
-
-	//Resize the buffer to match the new size
-	void* newBuf = realloc(buf, curLen+chars+1);
-	if (!newBuf) {return free(buf), false; /* Realloc Error */}
-	
-	//Print the string
-	va_start(vl,format);
-	vsnprintf(newBuf+curLen,newLen-curLen,format,vl);
-	va_end(vl);
+	//Leading and trailing whitespace is dropped
+	const char* text = ps->text + open->text_start;
+	const char* text_end = ps->text + ps->text_len;
+	while ((text < text_end) && is_space(*text)) {++text;}
+	while ((text_end > text) && is_space(text_end[-1])) {--text_end;}
+	node->value = parser_string(ps, text, (size_t) (text_end - text));
+	if (!node->value) {return false;}
+	ps->text_len = open->text_start;
 
-	//Update the buffer
-	*pBuf = newBuf;
+	size_t i;
+	for (i = open->child_start; i < ps->nodes_len; ++i) {ps->nodes[i]->parent = node;}
+	if (!parser_take(ps, &node->child_buffer, (void**) ps->nodes, open->child_start, &ps->nodes_len)) {return false;}
+
+	//Now it is a finished child of the element around it (or the root)
+	ps->open_len-=1;
+	if (ps->open_len == 0) {ps->root = node; return true;}
+	if (!PARSER_PUSH(ps, nodes, nodes_len, nodes_alloc, node)) {
+		free_xml_node((pXML_NODE_t) node);
+		return false;
+	}
 	return true;
 }
 
 
+//Read the root element and everything inside of it
+static bool parser_content(pXML_PARSER_t ps) {
+	if (!starts_with(ps, "<", 1) || starts_with(ps, "</", 2) || starts_with(ps, "<!", 2)) {return false;}
+
+	while (ps->root == NULL) {
+		if (ps->p >= ps->end) {return false;}
+
+		if (*ps->p != '<') {
+			const char* lt = memchr(ps->p, '<', (size_t) (ps->end - ps->p));
+			if (!lt) {return false;}
+
+			//Whitespace between tags is just formatting
+			const char* text = ps->p;
+			while ((text < lt) && is_space(*text)) {++text;}
+			if ((text < lt) && !parser_decode(ps, ps->p, lt)) {return false;}
+			ps->p = lt;
+		} else if (starts_with(ps, "</", 2)) {
+			pXML_PNODE_t node = ps->open[ps->open_len - 1].node;
+			size_t len = strlen(node->name);
+
+			ps->p += 2;
+			if (!starts_with(ps, node->name, len)) {return false;}
+			ps->p += len;
+			skip_space(ps);
+			if (!starts_with(ps, ">", 1)) {return false;}
+			++ps->p;
+			if (!parser_end_element(ps)) {return false;}
+		} else if (starts_with(ps, "<!--", 4)) {
+			ps->p += 4;
+			if (!skip_past(ps, "-->", 3)) {return false;}
+		} else if (starts_with(ps, "<![CDATA[", 9)) {
+			const char* start = ps->p + 9;
+			ps->p = start;
+			if (!skip_past(ps, "]]>", 3)) {return false;}
+			if (!parser_add_text(ps, start, (size_t) (ps->p - 3 - start))) {return false;}
+		} else if (starts_with(ps, "<?", 2)) {
+			if (!skip_past(ps, "?>", 2)) {return false;}
+		} else if (starts_with(ps, "<!", 2)) {
+			return false;	//Only comments and CDATA start with <! in here
+		} else {
+			++ps->p;
+			if (!parser_start_tag(ps)) {return false;}
+
+			if (starts_with(ps, "/>", 2)) {
+				ps->p += 2;
+				if (!parser_end_element(ps)) {return false;}
+			} else if (starts_with(ps, ">", 1)) {
+				++ps->p;
+			} else {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 
-static void xml_print_recurse(pXML_NODE_t node, size_t level) {
+//Free everything that was built before an error, along with the temporary buffers
+static void parser_cleanup(pXML_PARSER_t ps, bool ok) {
 	size_t i;
+	if (!ok) {
+		for (i = 0; i < ps->attribs_len; ++i) {free_xml_attrib((pXML_ATTRIB_t) ps->attribs[i]);}
+		for (i = 0; i < ps->nodes_len; ++i) {free_xml_node((pXML_NODE_t) ps->nodes[i]);}
+		for (i = 0; i < ps->open_len; ++i) {free_xml_node((pXML_NODE_t) ps->open[i].node);}
+		if (ps->root) {free_xml_node((pXML_NODE_t) ps->root);}
+		ps->root = NULL;
+	}
 
-	for (i = 0; i < level; ++i) {printf("  ");}
-	printf("<%s",node->name);
-	
-	for (i = 0; i < node->num_attrib; ++i) {
-		pXML_ATTRIB_t attr = node->attrib[i];
-		printf(" %s=\"%s\"",attr->name,attr->value);
+	free(ps->text);
+	free(ps->open);
+	free(ps->nodes);
+	free(ps->attribs);
+}
+
+
+pXML_NODE_t xml_parse(const char* text, size_t len) {
+	return xml_parse_alloc(text, len, NULL);
+}
+
+pXML_NODE_t xml_parse_alloc(const char* text, size_t len, pAllocator_t alloc) {
+	if (!text) {return NULL;}
+
+	XML_PARSER_t ps;
+	memset(&ps, 0, sizeof(XML_PARSER_t));
+	ps.p = text;
+	ps.end = text + len;
+	ps.alloc = alloc;
+
+	//Skip the UTF-8 byte order mark
+	if (starts_with(&ps, "\xEF\xBB\xBF", 3)) {ps.p += 3;}
+
+	bool ok = parser_skip_misc(&ps) && parser_content(&ps) && parser_skip_misc(&ps) && (ps.p == ps.end);
+	parser_cleanup(&ps, ok);
+	return (pXML_NODE_t) ps.root;
+}
+
+
+pXML_NODE_t xml_parse_file(const char* path) {
+	return xml_parse_file_alloc(path, NULL);
+}
+
+pXML_NODE_t xml_parse_file_alloc(const char* path, pAllocator_t alloc) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {return NULL;}
+
+	//Read the whole file (without relying on its size, so pipes work too)
+	char* buf = NULL;
+	size_t len = 0, buf_alloc = 0;
+	while (true) {
+		if (!parser_reserve((void**) &buf, &buf_alloc, len + 65536, 1)) {free(buf); fclose(file); return NULL;}
+		size_t got = fread(buf + len, 1, buf_alloc - len, file);
+		len += got;
+		if (got == 0) {break;}
+	}
+
+	bool error = ferror(file);
+	fclose(file);
+
+	pXML_NODE_t root = error ? NULL : xml_parse_alloc(buf, len, alloc);
+	free(buf);
+	return root;
+}
+
+
+
+
+
+
+//************************Event Parsing***************************
+
+#define XS_CONTENT		0		// Between tags, or reading text
+#define XS_COMMENT		1		// Inside of <!-- -->
+#define XS_CDATA		2		// Inside of <![CDATA[ ]]>
+#define XS_PI			3		// Inside of <? ?>
+#define XS_ERROR		4		// Not well-formed, out of memory, or stopped by a callback
+
+//Stream parser state
+//	Only the input that could not be parsed yet and the names of the open elements are kept,
+//	so memory does not depend on the size of the document
+typedef struct {
+	XML_Start_Func_t start_func;
+	XML_Text_Func_t text_func;
+	XML_End_Func_t end_func;
+	void* ctx;
+
+	int state;
+	bool started;			// Has any input been read? (For the byte order mark)
+	bool seen_root;
+	size_t tag_scan;		// How much of a partial start tag has already been searched for its '>'
+	char tag_quote;			//	... and whether that stopped inside of a quoted value
+
+	char* buf;				// Input that could not be parsed yet (always starts at a token)
+	size_t buf_len, buf_alloc;
+
+	char* path;				// Names of the open elements, each followed by '\0'
+	size_t path_len, path_alloc;
+	size_t* starts;			// Where each name starts in the path
+	size_t depth, starts_alloc;
+
+	char* scratch;			// Decoded text and attributes given to the callbacks
+	size_t scratch_alloc;
+	XML_ATTRIB_t* attribs;
+	size_t attribs_alloc;
+
+	char* capture;			// Name of the elements to build trees for (NULL for none)
+	XML_Node_Func_t node_func;
+	void* node_ctx;
+	XML_PARSER_t build;		// Builds the captured element, using the same code as xml_parse()
+	size_t seg_mark;		// Where the current run of text starts in the builder's text
+} XML_STREAM_t, *pXML_STREAM_t;
+
+
+pXML_Stream_t new_xml_stream(XML_Start_Func_t start, XML_Text_Func_t text, XML_End_Func_t end, void* ctx) {
+	pXML_STREAM_t xs = (pXML_STREAM_t) malloc(sizeof(XML_STREAM_t));
+	if (!xs) {return NULL;}
+
+	memset(xs, 0, sizeof(XML_STREAM_t));
+	xs->start_func = start;
+	xs->text_func = text;
+	xs->end_func = end;
+	xs->ctx = ctx;
+	xs->state = XS_CONTENT;
+	return (pXML_Stream_t) xs;
+}
+
+void free_xml_stream(pXML_Stream_t stream) {
+	pXML_STREAM_t xs = (pXML_STREAM_t) stream;
+	if (!xs) {return;}
+
+	parser_cleanup(&xs->build, false);
+	free(xs->buf);
+	free(xs->path);
+	free(xs->starts);
+	free(xs->scratch);
+	free(xs->attribs);
+	free(xs->capture);
+	free(xs);
+}
+
+bool xml_stream_capture(pXML_Stream_t stream, const char* name, XML_Node_Func_t func, void* ctx, pAllocator_t alloc) {
+	pXML_STREAM_t xs = (pXML_STREAM_t) stream;
+	if (!xs || !name || !func || xs->started) {return false;}
+
+	char* copy = (char*) malloc(strlen(name) + 1);
+	if (!copy) {return false;}
+	strcpy(copy, name);
+
+	free(xs->capture);
+	xs->capture = copy;
+	xs->node_func = func;
+	xs->node_ctx = ctx;
+	xs->build.alloc = alloc;
+	return true;
+}
+
+
+//Text of the captured element that is only whitespace is dropped, just like xml_parse()
+static void stream_text_done(pXML_STREAM_t xs) {
+	pXML_PARSER_t ps = &xs->build;
+	if (ps->open_len == 0) {return;}
+
+	size_t i;
+	for (i = xs->seg_mark; (i < ps->text_len) && is_space(ps->text[i]); ++i);
+	if (i == ps->text_len) {ps->text_len = xs->seg_mark;}
+	xs->seg_mark = ps->text_len;
+}
+
+static const char* stream_fail(pXML_STREAM_t xs) {
+	xs->state = XS_ERROR;
+	return NULL;
+}
+
+static bool stream_emit_text(pXML_STREAM_t xs, const char* text, size_t len) {
+	if ((xs->build.open_len > 0) && !parser_add_text(&xs->build, text, len)) {return false;}
+	return !xs->text_func || xs->text_func(xs->ctx, text, len);
+}
+
+
+//Text between tags (or whitespace outside of the root)
+static const char* stream_text(pXML_STREAM_t xs, const char* p, const char* end) {
+	const char* lt = memchr(p, '<', (size_t) (end - p));
+	const char* stop = lt ? lt : end;
+
+	if (xs->depth == 0) {
+		if (!xs->started && (*p == '\xEF')) {
+			if ((end - p < 3) && !memcmp(p, "\xEF\xBB\xBF", (size_t) (end - p))) {return p;}
+			if ((end - p >= 3) && !memcmp(p, "\xEF\xBB\xBF", 3)) {return p + 3;}
+		}
+		for (; p < stop; ++p) {
+			if (!is_space(*p)) {return stream_fail(xs);}
+		}
+		return stop;
+	}
+
+	//Wait for the rest of an entity that has been cut off (no matter how long it is, like xml_parse())
+	if (!lt) {
+		const char* amp = end;
+		while (amp > p) {
+			--amp;
+			if (*amp == ';') {break;}
+			if (*amp == '&') {stop = amp; break;}
+		}
+		if (stop == p) {return p;}
+	}
+
+	//Nothing to decode (the usual case) means the input can be passed along as-is
+	const char* amp = memchr(p, '&', (size_t) (stop - p));
+	if (!amp) {
+		if (!stream_emit_text(xs, p, (size_t) (stop - p))) {return stream_fail(xs);}
+		return stop;
 	}
 
-	printf(">%s",node->value);
-	if (node->num_children > 0) {
-		printf("\n");
+	if (!parser_reserve((void**) &xs->scratch, &xs->scratch_alloc, (size_t) (stop - p), 1)) {return stream_fail(xs);}
+	size_t len = decode_text(p, stop, xs->scratch);
+	if ((len == (size_t) -1) || !stream_emit_text(xs, xs->scratch, len)) {return stream_fail(xs);}
+	return stop;
+}
+
+
+//Skip a comment or processing instruction, up to and including close
+static const char* stream_skip(pXML_STREAM_t xs, const char* p, const char* end, const char* close, size_t len) {
+	const char* c = p;
+	while ((size_t) (end - c) >= len) {
+		c = memchr(c, close[0], (size_t) (end - c) - len + 1);
+		if (!c) {break;}
+		if (!memcmp(c, close, len)) {xs->state = XS_CONTENT; return c + len;}
+		++c;
+	}
+
+	//Keep what might be the start of close
+	return ((size_t) (end - p) >= len) ? (end - len + 1) : p;
+}
 
-		for (i = 0; i < node->num_children; ++i) {
-			xml_print_recurse(node->children[i],level+1);
+//CDATA is passed along as text, as soon as it arrives
+static const char* stream_cdata(pXML_STREAM_t xs, const char* p, const char* end) {
+	const char* c = p;
+	while (end - c >= 3) {
+		c = memchr(c, ']', (size_t) (end - c) - 2);
+		if (!c) {break;}
+		if (!memcmp(c, "]]>", 3)) {
+			if ((c > p) && !stream_emit_text(xs, p, (size_t) (c - p))) {return stream_fail(xs);}
+			xs->seg_mark = xs->build.text_len;
+			xs->state = XS_CONTENT;
+			return c + 3;
 		}
+		++c;
+	}
+
+	if (end - p < 3) {return p;}
+	if (!stream_emit_text(xs, p, (size_t) (end - 2 - p))) {return stream_fail(xs);}
+	return end - 2;
+}
+
+
+static bool stream_open(pXML_STREAM_t xs, const char* name, size_t len, size_t num_attrib) {
+	if (!parser_reserve((void**) &xs->path, &xs->path_alloc, xs->path_len + len + 1, 1)) {return false;}
+	if (!parser_reserve((void**) &xs->starts, &xs->starts_alloc, xs->depth + 1, sizeof(size_t))) {return false;}
+
+	char* copy = xs->path + xs->path_len;
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+	xs->starts[xs->depth++] = xs->path_len;
+	xs->path_len += len + 1;
+	xs->seen_root = true;
 
-		for (i = 0; i < level; ++i) {printf("  ");}
+	//Build the element if it is (or is inside of) one that was asked for
+	pXML_PARSER_t ps = &xs->build;
+	if ((ps->open_len > 0) || (xs->capture && !strcmp(copy, xs->capture))) {
+		if (!parser_open(ps, copy, len)) {return false;}
+
+		size_t i;
+		for (i = 0; i < num_attrib; ++i) {
+			const XML_ATTRIB_t* a = &xs->attribs[i];
+			if (!parser_attrib(ps, a->name, strlen(a->name), a->value, strlen(a->value), false)) {return false;}
+		}
+		if (!parser_open_done(ps)) {return false;}
+		xs->seg_mark = ps->text_len;
 	}
 
-	printf("</%s>\n",node->name);
+	return !xs->start_func || xs->start_func(xs->ctx, copy, xs->attribs, num_attrib);
 }
 
-void xml_print_node(pXML_NODE_t node) {
-	xml_print_recurse(node,0);
+static bool stream_close(pXML_STREAM_t xs) {
+	const char* name = xs->path + xs->starts[xs->depth - 1];
+	if (xs->end_func && !xs->end_func(xs->ctx, name)) {return false;}
+
+	xs->path_len = xs->starts[--xs->depth];
+
+	pXML_PARSER_t ps = &xs->build;
+	if (ps->open_len == 0) {return true;}
+	if (!parser_end_element(ps)) {return false;}
+	xs->seg_mark = ps->text_len;
+	if (!ps->root) {return true;}
+
+	//The callback owns the tree now
+	pXML_NODE_t root = (pXML_NODE_t) ps->root;
+	ps->root = NULL;
+	return xs->node_func(xs->node_ctx, root);
+}
+
+
+//Read a start tag, which can only be parsed once its '>' is here
+static const char* stream_start_tag(pXML_STREAM_t xs, const char* p, const char* end) {
+	const char* c = p + ((xs->tag_scan > 0) ? xs->tag_scan : 1);
+	char quote = xs->tag_quote;
+	for (; c < end; ++c) {
+		if (quote) {
+			const char* q = memchr(c, quote, (size_t) (end - c));
+			if (!q) {c = end; break;}
+			c = q;
+			quote = '\0';
+		} else if ((*c == '"') || (*c == '\'')) {
+			quote = *c;
+		} else if (*c == '>') {
+			break;
+		}
+	}
+	if (c == end) {
+		xs->tag_scan = (size_t) (end - p);
+		xs->tag_quote = quote;
+		return p;
+	}
+	xs->tag_scan = 0;
+	xs->tag_quote = '\0';
+
+	const char* gt = c;
+	bool empty = (gt[-1] == '/');
+	const char* tag_end = empty ? (gt - 1) : gt;
+	if ((xs->depth == 0) && xs->seen_root) {return stream_fail(xs);}
+
+	//Attributes are decoded into scratch, which has room for all of them up front (so the pointers stay put)
+	if (!parser_reserve((void**) &xs->scratch, &xs->scratch_alloc, 2 * (size_t) (gt - p), 1)) {return stream_fail(xs);}
+	char* out = xs->scratch;
+	size_t num_attrib = 0;
+
+	const char* name = p + 1;
+	for (c = name; (c < tag_end) && !is_name_end(*c); ++c);
+	if (c == name) {return stream_fail(xs);}
+	size_t name_len = (size_t) (c - name);
+
+	while (true) {
+		const char* attr = c;
+		while ((c < tag_end) && is_space(*c)) {++c;}
+		if (c == tag_end) {break;}
+		if (c == attr) {return stream_fail(xs);}	//Needs whitespace before it
+
+		attr = c;
+		while ((c < tag_end) && !is_name_end(*c)) {++c;}
+		if (c == attr) {return stream_fail(xs);}
+		size_t attr_len = (size_t) (c - attr);
+
+		while ((c < tag_end) && is_space(*c)) {++c;}
+		if ((c == tag_end) || (*c != '=')) {return stream_fail(xs);}
+		++c;
+		while ((c < tag_end) && is_space(*c)) {++c;}
+		if ((c == tag_end) || ((*c != '"') && (*c != '\''))) {return stream_fail(xs);}
+
+		const char* value = c + 1;
+		const char* close = memchr(value, *c, (size_t) (tag_end - value));
+		if (!close) {return stream_fail(xs);}
+		c = close + 1;
+
+		if (!parser_reserve((void**) &xs->attribs, &xs->attribs_alloc, num_attrib + 1, sizeof(XML_ATTRIB_t))) {return stream_fail(xs);}
+		XML_ATTRIB_t* a = &xs->attribs[num_attrib++];
+		a->name = out;
+		memcpy(out, attr, attr_len);
+		out += attr_len;
+		*out++ = '\0';
+
+		a->value = out;
+		size_t len = decode_text(value, close, out);
+		if (len == (size_t) -1) {return stream_fail(xs);}
+		out += len;
+		*out++ = '\0';
+	}
+
+	if (!stream_open(xs, name, name_len, num_attrib)) {return stream_fail(xs);}
+	if (empty && !stream_close(xs)) {return stream_fail(xs);}
+	return gt + 1;
+}
+
+static const char* stream_end_tag(pXML_STREAM_t xs, const char* p, const char* end) {
+	const char* gt = memchr(p, '>', (size_t) (end - p));
+	if (!gt) {return p;}
+	if (xs->depth == 0) {return stream_fail(xs);}
+
+	//Must match the innermost open element
+	const char* name = xs->path + xs->starts[xs->depth - 1];
+	size_t len = xs->path_len - xs->starts[xs->depth - 1] - 1;
+	const char* c = p + 2;
+	if (((size_t) (gt - c) < len) || memcmp(c, name, len)) {return stream_fail(xs);}
+	for (c += len; c < gt; ++c) {
+		if (!is_space(*c)) {return stream_fail(xs);}
+	}
+
+	if (!stream_close(xs)) {return stream_fail(xs);}
+	return gt + 1;
+}
+
+//Find the end of a DOCTYPE, including any internal subset in brackets
+static const char* stream_doctype(pXML_STREAM_t xs, const char* p, const char* end) {
+	if (xs->seen_root) {return stream_fail(xs);}
+
+	const char* c;
+	int brackets = 0;
+	char quote = '\0';
+	for (c = p + 9; c < end; ++c) {
+		if (quote) {
+			if (*c == quote) {quote = '\0';}
+		} else if ((*c == '"') || (*c == '\'')) {
+			quote = *c;
+		} else if (*c == '[') {
+			++brackets;
+		} else if ((*c == ']') && (brackets > 0)) {
+			--brackets;
+		} else if ((*c == '>') && (brackets == 0)) {
+			return c + 1;
+		}
+	}
+	return p;
+}
+
+
+//Does the input at p start with str? (Or could it, once there is more)
+static inline int stream_match(const char* p, const char* end, const char* str, size_t len) {
+	size_t avail = (size_t) (end - p);
+	if (avail < len) {return memcmp(p, str, avail) ? 0 : -1;}
+	return memcmp(p, str, len) ? 0 : 1;
+}
+
+//Anything that starts with a '<'
+static const char* stream_markup(pXML_STREAM_t xs, const char* p, const char* end) {
+	stream_text_done(xs);
+	if (end - p < 2) {return p;}
+
+	if (p[1] == '/') {return stream_end_tag(xs, p, end);}
+	if (p[1] == '?') {xs->state = XS_PI; return p + 2;}
+	if (p[1] != '!') {return stream_start_tag(xs, p, end);}
+
+	int m;
+	if ((m = stream_match(p, end, "<!--", 4)) != 0) {
+		if (m < 0) {return p;}
+		xs->state = XS_COMMENT;
+		return p + 4;
+	}
+	if ((m = stream_match(p, end, "<![CDATA[", 9)) != 0) {
+		if (m < 0) {return p;}
+		if (xs->depth == 0) {return stream_fail(xs);}
+		xs->state = XS_CDATA;
+		return p + 9;
+	}
+	if ((m = stream_match(p, end, "<!DOCTYPE", 9)) != 0) {
+		if (m < 0) {return p;}
+		return stream_doctype(xs, p, end);
+	}
+	return stream_fail(xs);
+}
+
+
+//Parse as much of [start, end) as possible, returning how much was used
+static size_t stream_parse(pXML_STREAM_t xs, const char* start, const char* end) {
+	const char* p = start;
+	while (p < end) {
+		const char* next;
+		switch (xs->state) {
+			case XS_COMMENT:	next = stream_skip(xs, p, end, "-->", 3); break;
+			case XS_PI:			next = stream_skip(xs, p, end, "?>", 2); break;
+			case XS_CDATA:		next = stream_cdata(xs, p, end); break;
+			default:			next = (*p == '<') ? stream_markup(xs, p, end) : stream_text(xs, p, end); break;
+		}
+
+		if (!next) {return 0;}
+		if (next == p) {break;}	//Wait for more input
+		p = next;
+		xs->started = true;
+	}
+	return (size_t) (p - start);
+}
+
+
+bool xml_stream_feed(pXML_Stream_t stream, const char* data, size_t len) {
+	pXML_STREAM_t xs = (pXML_STREAM_t) stream;
+	if (!xs || (xs->state == XS_ERROR)) {return false;}
+	if (len == 0) {return true;}
+
+	//Parse straight out of data when nothing is left over, and only copy what could not be parsed
+	const char* src = data;
+	if (xs->buf_len > 0) {
+		if (!parser_reserve((void**) &xs->buf, &xs->buf_alloc, xs->buf_len + len, 1)) {return stream_fail(xs), false;}
+		memcpy(xs->buf + xs->buf_len, data, len);
+		len += xs->buf_len;
+		src = xs->buf;
+	}
+
+	size_t used = stream_parse(xs, src, src + len);
+	if (xs->state == XS_ERROR) {return false;}
+
+	size_t left = len - used;
+	if ((src == data) && (left > 0)) {
+		if (!parser_reserve((void**) &xs->buf, &xs->buf_alloc, left, 1)) {return stream_fail(xs), false;}
+		memcpy(xs->buf, data + used, left);
+	} else if ((src != data) && (used > 0)) {
+		memmove(xs->buf, xs->buf + used, left);
+	}
+	xs->buf_len = left;
+	return true;
+}
+
+bool xml_stream_finish(pXML_Stream_t stream) {
+	pXML_STREAM_t xs = (pXML_STREAM_t) stream;
+	if (!xs || (xs->state != XS_CONTENT)) {return false;}
+	return xs->seen_root && (xs->depth == 0) && (xs->buf_len == 0);
+}
+
+
+
+
+
+
+//************************XML Documents***************************
+
+#define DOC_BLOCK_SIZE	65536		// Default size of each block in a document's arena
+
+//Document object
+//	Every node, attribute, string and array comes from the arena
+typedef struct {
+	Allocator_t base;		// Given to every node in the document (the arena's functions, except free)
+	pAllocator_t arena;
+	pXML_NODE_t root;
+} XML_DOC_t, *pXML_DOC_t;
+
+
+pXML_Doc_t new_xml_doc() {
+	return new_xml_doc_size(DOC_BLOCK_SIZE);
+}
+
+pXML_Doc_t new_xml_doc_size(size_t block_size) {
+	pXML_DOC_t doc = (pXML_DOC_t) malloc(sizeof(XML_DOC_t));
+	if (!doc) {return NULL;}
+
+	doc->arena = new_arena_allocator(block_size);
+	if (!doc->arena) {free(doc); return NULL;}
+
+	doc->base = *doc->arena;
+	doc->base.free = doc_free;
+	doc->root = NULL;
+	return (pXML_Doc_t) doc;
+}
+
+void free_xml_doc(pXML_Doc_t d) {
+	pXML_DOC_t doc = (pXML_DOC_t) d;
+	if (!doc) {return;}
+
+	free_arena_allocator(doc->arena);
+	free(doc);
+}
+
+void xml_doc_reset(pXML_Doc_t d) {
+	pXML_DOC_t doc = (pXML_DOC_t) d;
+	arena_reset(doc->arena);
+	doc->root = NULL;
+}
+
+
+pAllocator_t xml_doc_allocator(pXML_Doc_t d) {
+	return &((pXML_DOC_t) d)->base;
+}
+
+size_t xml_doc_get_used(pXML_Doc_t d) {
+	return arena_get_used(((pXML_DOC_t) d)->arena);
 }
 
 
+pXML_NODE_t xml_doc_root(pXML_Doc_t d) {
+	return ((pXML_DOC_t) d)->root;
+}
+
+void xml_doc_set_root(pXML_Doc_t d, pXML_NODE_t root) {
+	((pXML_DOC_t) d)->root = root;
+}
+
+
+pXML_NODE_t xml_doc_new_node(pXML_Doc_t d) {
+	return new_xml_node_alloc(xml_doc_allocator(d));
+}
 
-//Just like sprintf_cat, but returns false on failure
-//	This makes the code slightly more ledgible
-#define sprintf_c(pBuf,format,...) if (!sprintf_cat((pBuf),(format),##__VA_ARGS__)) {return false;}
+pXML_ATTRIB_t xml_doc_new_attrib(pXML_Doc_t d) {
+	return new_xml_attrib_alloc(xml_doc_allocator(d));
+}
+
+pXML_NODE_t xml_doc_import(pXML_Doc_t d, pXML_NODE_t node) {
+	if (!node) {return NULL;}
+	return duplicate_xml_node_alloc(node, xml_doc_allocator(d));
+}
+
+
+pXML_NODE_t xml_doc_parse(pXML_Doc_t d, const char* text, size_t len) {
+	pXML_DOC_t doc = (pXML_DOC_t) d;
+	pXML_NODE_t root = xml_parse_alloc(text, len, &doc->base);
+	if (root) {doc->root = root;}
+	return root;
+}
 
-static bool xml_to_string_recurse(pXML_NODE_t node, size_t level, char** pBuf) {
+pXML_NODE_t xml_doc_parse_file(pXML_Doc_t d, const char* path) {
+	pXML_DOC_t doc = (pXML_DOC_t) d;
+	pXML_NODE_t root = xml_parse_file_alloc(path, &doc->base);
+	if (root) {doc->root = root;}
+	return root;
+}
+
+
+
+
+
+
+//************************Print and Debug***************************
+
+#define WRITE_BLOCK		4096		// Output is gathered into blocks this big before it is handed off
+
+//Serializer state
+//	Without a write function, buf is the output string itself and keeps growing.
+//	Otherwise it is a fixed block that is passed to func every time it fills up
+typedef struct {
+	char* buf;
+	size_t len, alloc;
+	XML_Write_Func_t func;
+	void* ctx;
+	bool ok;				// Becomes false on the first error, and everything after it is ignored
+} XML_WRITER_t, *pXML_WRITER_t;
+
+//An element that has been written out up to its children
+typedef struct {
+	pXML_NODE_t node;
+	size_t next;			// Next child to write
+} XML_WRITE_FRAME_t;
+
+
+static void writer_flush(pXML_WRITER_t w) {
+	if (w->ok && (w->len > 0)) {w->ok = w->func(w->ctx, w->buf, w->len);}
+	w->len = 0;
+}
+
+static void writer_put(pXML_WRITER_t w, const char* str, size_t len) {
+	if (!w->ok) {return;}
+	if (w->len + len > w->alloc) {
+		if (!w->func) {
+			w->ok = parser_reserve((void**) &w->buf, &w->alloc, w->len + len, 1);
+			if (!w->ok) {return;}
+		} else {
+			writer_flush(w);
+			if (len > w->alloc) {	//Too big to be worth copying
+				if (w->ok) {w->ok = w->func(w->ctx, str, len);}
+				return;
+			}
+		}
+	}
+
+	memcpy(w->buf + w->len, str, len);
+	w->len += len;
+}
+
+static inline void writer_str(pXML_WRITER_t w, const char* str) {
+	if (str) {writer_put(w, str, strlen(str));}
+}
 
+//Turn anything that would break the markup into entities (and quotes too, for attributes)
+static void writer_escape(pXML_WRITER_t w, const char* str, bool attrib) {
+	if (!str) {return;}
+	while (true) {
+		size_t len = strcspn(str, attrib ? "&<>\"" : "&<>");
+		writer_put(w, str, len);
+		str += len;
+
+		switch (*str) {
+			case '&': writer_put(w, "&amp;", 5); break;
+			case '<': writer_put(w, "&lt;", 4); break;
+			case '>': writer_put(w, "&gt;", 4); break;
+			case '"': writer_put(w, "&quot;", 6); break;
+			default: return;
+		}
+		++str;
+	}
+}
+
+static void writer_indent(pXML_WRITER_t w, const XML_FORMAT_t* fmt, size_t level) {
+	static const char spaces[] = "                                ";
+	if (fmt->compact) {return;}
+
+	size_t n = level * fmt->indent;
+	while (n > 0) {
+		size_t len = (n < sizeof(spaces) - 1) ? n : (sizeof(spaces) - 1);
+		writer_put(w, spaces, len);
+		n -= len;
+	}
+}
+
+static void writer_open(pXML_WRITER_t w, const XML_FORMAT_t* fmt, pXML_NODE_t node, size_t level) {
 	size_t i;
+	writer_indent(w, fmt, level);
+	writer_put(w, "<", 1);
+	writer_str(w, node->name);
 
-	for (i = 0; i < level; ++i) {sprintf_c(pBuf,"  ");}
-	sprintf_c(pBuf,"<%s",node->name);
-	
 	for (i = 0; i < node->num_attrib; ++i) {
 		pXML_ATTRIB_t attr = node->attrib[i];
-		sprintf_c(pBuf," %s=\"%s\"",attr->name,attr->value);
+		writer_put(w, " ", 1);
+		writer_str(w, attr->name);
+		writer_put(w, "=\"", 2);
+		writer_escape(w, attr->value, true);
+		writer_put(w, "\"", 1);
 	}
 
-	sprintf_c(pBuf,">%s",node->value);
-	if (node->num_children > 0) {
-		sprintf_c(pBuf,"\n");
+	writer_put(w, ">", 1);
+	writer_escape(w, node->value, false);
+	if ((node->num_children > 0) && !fmt->compact) {writer_put(w, "\n", 1);}
+}
+
+static void writer_close(pXML_WRITER_t w, const XML_FORMAT_t* fmt, pXML_NODE_t node, size_t level) {
+	if (node->num_children > 0) {writer_indent(w, fmt, level);}
+	writer_put(w, "</", 2);
+	writer_str(w, node->name);
+	writer_put(w, ">", 1);
+	if (!fmt->compact) {writer_put(w, "\n", 1);}
+}
 
-		for (i = 0; i < node->num_children; ++i) {
-			if (!xml_to_string_recurse(node->children[i],level+1,pBuf)) {
-				return false;
-			}
-		}
 
-		for (i = 0; i < level; ++i) {sprintf_c(pBuf,"  ");}
+//Write the whole tree in one pass, keeping a stack instead of recursing (so deep trees are fine)
+static bool writer_tree(pXML_WRITER_t w, pXML_NODE_t node, const XML_FORMAT_t* fmt) {
+	static const XML_FORMAT_t def_fmt = {2, false};
+	if (!fmt) {fmt = &def_fmt;}
+	if (!node) {return (w->ok = false);}
+
+	XML_WRITE_FRAME_t* stack = NULL;
+	size_t len = 0, alloc = 0;
+
+	writer_open(w, fmt, node, 0);
+	XML_WRITE_FRAME_t frame = {node, 0};
+	if (!parser_reserve((void**) &stack, &alloc, 1, sizeof(XML_WRITE_FRAME_t))) {return (w->ok = false);}
+	stack[len++] = frame;
+
+	while ((len > 0) && w->ok) {
+		XML_WRITE_FRAME_t* top = &stack[len - 1];
+		if (top->next < top->node->num_children) {
+			frame.node = top->node->children[top->next++];
+			writer_open(w, fmt, frame.node, len);
+			if (!parser_reserve((void**) &stack, &alloc, len + 1, sizeof(XML_WRITE_FRAME_t))) {w->ok = false; break;}
+			stack[len++] = frame;
+		} else {
+			--len;
+			writer_close(w, fmt, top->node, len);
+		}
 	}
 
-	sprintf_c(pBuf,"</%s>\n",node->name);
+	free(stack);
+	return w->ok;
+}
+
+
+bool xml_write(pXML_NODE_t node, XML_Write_Func_t func, void* ctx, const XML_FORMAT_t* fmt) {
+	if (!func) {return false;}
+
+	char block[WRITE_BLOCK];
+	XML_WRITER_t w = {block, 0, WRITE_BLOCK, func, ctx, true};
+	writer_tree(&w, node, fmt);
+	writer_flush(&w);
+	return w.ok;
+}
+
+
+static bool write_file_func(void* ctx, const char* data, size_t len) {
+	return fwrite(data, 1, len, (FILE*) ctx) == len;
+}
+
+bool xml_write_file(pXML_NODE_t node, FILE* file, const XML_FORMAT_t* fmt) {
+	return file && xml_write(node, write_file_func, file, fmt);
+}
+
+
+#ifdef XML_WRITE_FD
+
+static bool write_fd_func(void* ctx, const char* data, size_t len) {
+	int fd = *(int*) ctx;
+	while (len > 0) {
+		ssize_t res = write(fd, data, len);
+		if (res < 0) {
+			if (errno == EINTR) {continue;}
+			return false;
+		}
+		if (res == 0) {return false;}
+
+		data += res;
+		len -= (size_t) res;
+	}
 	return true;
 }
 
+bool xml_write_fd(pXML_NODE_t node, int fd, const XML_FORMAT_t* fmt) {
+	return xml_write(node, write_fd_func, &fd, fmt);
+}
 
-char* xml_to_string(pXML_NODE_t node) {
-	char* buf = NULL;
-	xml_to_string_recurse(node,0,&buf);
+#else
+
+//No file descriptors on this platform
+bool xml_write_fd(pXML_NODE_t node, int fd, const XML_FORMAT_t* fmt) {(void) node; (void) fd; (void) fmt; return false;}
+
+#endif // XML_WRITE_FD
+
+
+char* xml_to_string_fmt(pXML_NODE_t node, const XML_FORMAT_t* fmt, size_t* len) {
+	XML_WRITER_t w = {NULL, 0, 0, NULL, NULL, true};
+	writer_tree(&w, node, fmt);
+	writer_put(&w, "", 1);	//Null terminator
+	if (!w.ok) {free(w.buf); return NULL;}
+
+	//Give back the extra room
+	char* buf = realloc(w.buf, w.len);
+	if (!buf) {buf = w.buf;}
+	if (len) {*len = w.len - 1;}
 	return buf;
 }
+
+char* xml_to_string(pXML_NODE_t node) {
+	return xml_to_string_fmt(node, NULL, NULL);
+}
+
+void xml_print_node(pXML_NODE_t node) {
+	xml_write_file(node, stdout, NULL);
+}
@@ -4,6 +4,8 @@
 
 #include <stdbool.h>		/* For bool data type */
 #include <stddef.h>			/* For size_t data type */
+#include <stdio.h>			/* For FILE */
+#include "allocator.h"
 
 
 //XML Attribute Object
@@ -31,6 +33,7 @@ typedef struct XML_NODE_t {
 //************XML Attributes************
 
 pXML_ATTRIB_t new_xml_attrib();
+pXML_ATTRIB_t new_xml_attrib_alloc(pAllocator_t alloc);		// NULL uses malloc and free
 pXML_ATTRIB_t duplicate_xml_attrib(pXML_ATTRIB_t);
 void free_xml_attrib(pXML_ATTRIB_t);
 
@@ -42,18 +45,107 @@ void xml_attrib_set_value(pXML_ATTRIB_t node, char* value, bool copy);
 //************XML Nodes***************
 
 pXML_NODE_t new_xml_node();
-pXML_NODE_t duplicate_xml_node(pXML_NODE_t);
+pXML_NODE_t new_xml_node_alloc(pAllocator_t alloc);			// NULL uses malloc and free
+pXML_NODE_t duplicate_xml_node(pXML_NODE_t);				// NULL if memory runs out
 void free_xml_node(pXML_NODE_t node);
 
+//If copy is false, the node takes ownership of the string (it must come from the node's allocator)
 void xml_set_name(pXML_NODE_t node, char* name, bool copy);
 void xml_set_value(pXML_NODE_t node, char* value, bool copy);
-void xml_add_attrib(pXML_NODE_t node, pXML_ATTRIB_t attr, bool copy);
-void xml_add_child_node(pXML_NODE_t node, pXML_NODE_t child, bool copy);
+//Both return false (and add nothing) if memory runs out
+bool xml_add_attrib(pXML_NODE_t node, pXML_ATTRIB_t attr, bool copy);
+bool xml_add_child_node(pXML_NODE_t node, pXML_NODE_t child, bool copy);	// Copies use node's allocator
+
+
+
+//************Parsing**************
+
+//Build a tree from XML text in one pass, returning the root element (or NULL if the text is not well-formed)
+//	Handles attributes, text, CDATA, comments, entities and self-closing tags. All of the text directly inside
+//	of an element becomes its value (with entities decoded, and leading or trailing whitespace removed,
+//	along with any text that is only whitespace).
+//	Comments, processing instructions and the DOCTYPE are skipped. Free the tree with free_xml_node()
+pXML_NODE_t xml_parse(const char* text, size_t len);
+pXML_NODE_t xml_parse_alloc(const char* text, size_t len, pAllocator_t alloc);
+
+pXML_NODE_t xml_parse_file(const char* path);
+pXML_NODE_t xml_parse_file_alloc(const char* path, pAllocator_t alloc);
+
+
+
+//************Event Parsing**************
+
+//Callbacks for the stream parser (return false to stop parsing)
+//	Strings only last until the callback returns. Attributes have their entities decoded
+typedef bool (*XML_Start_Func_t)(void* ctx, const char* name, const XML_ATTRIB_t* attrib, size_t num_attrib);
+typedef bool (*XML_Text_Func_t)(void* ctx, const char* text, size_t len);		// Text can arrive in several pieces
+typedef bool (*XML_End_Func_t)(void* ctx, const char* name);
+typedef bool (*XML_Node_Func_t)(void* ctx, pXML_NODE_t node);					// Free the node with free_xml_node()
+
+typedef void* pXML_Stream_t;
+
+//Push parser that takes the document in chunks of any size, and calls back as soon as it reads something
+//	Only the names of the open elements and any token cut off at the end of a chunk are kept,
+//	so it can read documents much bigger than memory. Any of the callbacks can be NULL.
+//	All text (including whitespace between tags, and CDATA) goes to the text callback
+pXML_Stream_t new_xml_stream(XML_Start_Func_t start, XML_Text_Func_t text, XML_End_Func_t end, void* ctx);
+void free_xml_stream(pXML_Stream_t stream);
+
+//Build a tree (just like xml_parse() would) for every element with this name, and pass it to func
+//	The other callbacks still run inside of those elements. Has to be called before the first chunk
+bool xml_stream_capture(pXML_Stream_t stream, const char* name, XML_Node_Func_t func, void* ctx, pAllocator_t alloc);
+
+bool xml_stream_feed(pXML_Stream_t stream, const char* data, size_t len);		// False if not well-formed (or stopped)
+bool xml_stream_finish(pXML_Stream_t stream);		// True if the whole document was read
+
+
+
+//************XML Documents**************
+
+//A document owns an arena that every node, attribute and string in it comes from,
+//	so the whole tree is released at once by free_xml_doc() (or xml_doc_reset(), to build another one).
+//	free_xml_node() and friends do nothing on anything in a document. Only link nodes from the same document
+typedef void* pXML_Doc_t;
+
+pXML_Doc_t new_xml_doc();
+pXML_Doc_t new_xml_doc_size(size_t block_size);		// Bytes in each block of the arena
+void free_xml_doc(pXML_Doc_t doc);
+void xml_doc_reset(pXML_Doc_t doc);					// Keeps some memory around for the next document
+
+pAllocator_t xml_doc_allocator(pXML_Doc_t doc);		// For the *_alloc() functions, and xml_stream_capture()
+size_t xml_doc_get_used(pXML_Doc_t doc);			// Bytes used by the document
+
+pXML_NODE_t xml_doc_root(pXML_Doc_t doc);
+void xml_doc_set_root(pXML_Doc_t doc, pXML_NODE_t root);
+
+pXML_NODE_t xml_doc_new_node(pXML_Doc_t doc);
+pXML_ATTRIB_t xml_doc_new_attrib(pXML_Doc_t doc);
+pXML_NODE_t xml_doc_import(pXML_Doc_t doc, pXML_NODE_t node);		// Copies the tree into the document
+
+//Same as xml_parse(), and the root becomes the document's root
+pXML_NODE_t xml_doc_parse(pXML_Doc_t doc, const char* text, size_t len);
+pXML_NODE_t xml_doc_parse_file(pXML_Doc_t doc, const char* path);
 
 
 
 //************Print and Debug**************
 
+//Layout of the serialized text (NULL means the default: indent by 2, one element per line)
+typedef struct {
+	size_t indent;		// Spaces per level
+	bool compact;		// No line breaks or indenting at all
+} XML_FORMAT_t;
+
+//Called with each block of output, returns false on an error
+typedef bool (*XML_Write_Func_t)(void* ctx, const char* data, size_t len);
+
+//Serialize the tree in one pass, with '&', '<', '>' (and '"' in attributes) written as entities
+//	Output is sent in blocks, so nothing the size of the document is ever built up
+bool xml_write(pXML_NODE_t node, XML_Write_Func_t func, void* ctx, const XML_FORMAT_t* fmt);
+bool xml_write_file(pXML_NODE_t node, FILE* file, const XML_FORMAT_t* fmt);
+bool xml_write_fd(pXML_NODE_t node, int fd, const XML_FORMAT_t* fmt);		// Only on unix
+char* xml_to_string_fmt(pXML_NODE_t node, const XML_FORMAT_t* fmt, size_t* len);		// len is optional
+
 void xml_print_node(pXML_NODE_t node);
 char* xml_to_string(pXML_NODE_t node);		// Be sure to free the string when done
 